@@ -0,0 +1,41 @@
+#ifndef SCOUT_RF_BENCH_H
+#define SCOUT_RF_BENCH_H
+
+/* Benchmark markers shared by the src/bench.cpp firmware and the simavr runner
+ *
+ * Firmware writes a benchmark id to GPIOR0 right before the code under test and BENCH_END right after it, the runner
+ * timestamps both writes with the simavr cycle counter. BENCH_DONE ends the run.
+ */
+
+// GPIOR0 I/O address on ATtiny85, data space address is 0x20 higher.
+#define BENCH_MARKER_IO 0x11
+#define BENCH_END 0x00
+#define BENCH_DONE 0xFF
+
+#define BENCH_LIST(X) \
+  X(EMPTY, "marker overhead") \
+  X(SPI_BYTE, "HalfDuplexSPI::byte") \
+  X(SPI_IN, "HalfDuplexSPI::in") \
+  X(SPI_OUT, "HalfDuplexSPI::out") \
+  X(SPI_OUT_BURST, "HalfDuplexSPI::outBurst/32") \
+  X(SPI_IN_BURST, "HalfDuplexSPI::inBurst/32") \
+  X(CSN_LOW, "Radio::csnLow") \
+  X(CSN_HIGH, "Radio::csnHigh") \
+  X(READ_REGISTER, "Radio::read_register") \
+  X(WRITE_REGISTER, "Radio::write_register") \
+  X(WRITE_PAYLOAD, "Radio::write_payload/5") \
+  X(READ_PAYLOAD, "Radio::read_payload/5") \
+  X(WRITE_PAYLOAD_DYNAMIC, "Radio::write_payload/5/dynamic") \
+  X(READ_PAYLOAD_DYNAMIC, "Radio::read_payload/5/dynamic") \
+  X(POWER_UP, "Radio::powerUp") \
+  X(STOP_LISTENING, "Radio::stopListening")
+
+#define BENCH_ID(id, name) BENCH_##id,
+
+enum BenchId {
+  BENCH_FIRST = 0,
+  BENCH_LIST(BENCH_ID)
+  BENCH_COUNT
+};
+
+#endif //SCOUT_RF_BENCH_H
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds the bench firmware env and the simavr runner, then writes cycle counts to bench/results.json
+# (or the path given as the first argument). Compare the file before and after a change to SPI or radio code.
+set -e
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+results="${1:-$root/bench/results.json}"
+
+cd "$root"
+platformio run -e bench
+
+# PlatformIO 3 builds into .pioenvs, newer versions into .pio/build.
+elf="$root/.pioenvs/bench/firmware.elf"
+[ -f "$elf" ] || elf="$root/.pio/build/bench/firmware.elf"
+
+cmake -S "$root/bench" -B "$root/bench/build"
+cmake --build "$root/bench/build"
+
+"$root/bench/build/bench-runner" "$elf" "$results"
+cat "$results"
@@ -0,0 +1,107 @@
+/* simavr runner for the src/bench.cpp firmware
+ *
+ * Usage: bench-runner firmware.elf [results.json]
+ *
+ * Reports cycles spent between the GPIOR0 markers of each benchmark, with the marker overhead subtracted, as JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+
+#include "bench.h"
+
+#define F_CPU 8000000
+#define MAX_CYCLES 1000000000ULL
+
+#define BENCH_NAME(id, name) name,
+
+static const char *names[BENCH_COUNT] = {
+  "",
+  BENCH_LIST(BENCH_NAME)
+};
+
+static avr_cycle_count_t started;
+static avr_cycle_count_t cycles[BENCH_COUNT];
+static uint8_t current = 0;
+static int done = 0;
+
+static void on_marker(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param) {
+  (void) addr;
+  (void) param;
+
+  if (value == BENCH_DONE) {
+    done = 1;
+  } else if (value == BENCH_END) {
+    if (current) {
+      cycles[current] = avr->cycle - started;
+    }
+    current = 0;
+  } else if (value < BENCH_COUNT) {
+    current = value;
+    started = avr->cycle;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s firmware.elf [results.json]\n", argv[0]);
+    return 1;
+  }
+
+  elf_firmware_t firmware = {{0}};
+  if (elf_read_firmware(argv[1], &firmware)) {
+    fprintf(stderr, "Unable to load %s\n", argv[1]);
+    return 1;
+  }
+
+  avr_t *avr = avr_make_mcu_by_name("attiny85");
+  if (!avr) {
+    fprintf(stderr, "simavr is built without attiny85 support\n");
+    return 1;
+  }
+
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->frequency = F_CPU;
+
+  avr_register_io_write(avr, BENCH_MARKER_IO + 0x20, on_marker, NULL);
+
+  int state = cpu_Running;
+  while (!done && (state == cpu_Running || state == cpu_Sleeping) && avr->cycle < MAX_CYCLES) {
+    state = avr_run(avr);
+  }
+
+  if (!done) {
+    fprintf(stderr, "Benchmark firmware didn't finish, state %d after %llu cycles\n", state,
+            (unsigned long long) avr->cycle);
+    return 1;
+  }
+
+  FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Unable to write %s\n", argv[2]);
+    return 1;
+  }
+
+  avr_cycle_count_t overhead = cycles[BENCH_EMPTY];
+
+  fprintf(out, "{\n  \"f_cpu\": %d,\n  \"overhead\": %llu,\n  \"cycles\": {\n", F_CPU,
+          (unsigned long long) overhead);
+
+  for (int id = BENCH_EMPTY + 1; id < BENCH_COUNT; id++) {
+    fprintf(out, "    \"%s\": %llu%s\n", names[id], (unsigned long long) (cycles[id] - overhead),
+            id + 1 < BENCH_COUNT ? "," : "");
+  }
+
+  fprintf(out, "  }\n}\n");
+
+  if (out != stdout) {
+    fclose(out);
+  }
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include <avr/eeprom.h>
+#include <util/delay.h>
+#include <util/delay_basic.h>
+
+#include "halfduplexspi.h"
+#include "lowpower.h"
+#include "nrf24model.h"
+
+/* Host implementations of the AVR facilities lib/radio relies on, all routed to the nRF24L01+ model, and of the
+ * WDT sleeps lib/scheduler relies on. */
+
+volatile uint8_t PINB, DDRB, PORTB, PCMSK, GIMSK;
+
+SpiPort spiPort;
+
+WdtModel wdt;
+
+SpiPort &SpiPort::operator&=(uint8_t mask) {
+  if (!(mask & _BV(SPI_SCK))) {
+    nrf24.csnLow();
+  }
+
+  return *this;
+}
+
+SpiPort &SpiPort::operator|=(uint8_t mask) {
+  if (mask & _BV(SPI_SCK)) {
+    nrf24.csnHigh();
+  }
+
+  return *this;
+}
+
+void HalfDuplexSPI::setup(void) {
+}
+
+uint8_t HalfDuplexSPI::byte(uint8_t dataout) {
+  nrf24.spend(SPI_BYTE_CYCLES);
+  return nrf24.transfer(dataout);
+}
+
+uint8_t HalfDuplexSPI::in(void) {
+  nrf24.spend(SPI_IN_CYCLES);
+  return nrf24.transfer(0);
+}
+
+void HalfDuplexSPI::out(uint8_t dataout) {
+  nrf24.spend(SPI_OUT_CYCLES);
+  nrf24.transfer(dataout);
+}
+
+void HalfDuplexSPI::outBurst(const uint8_t *buf, uint8_t len) {
+  nrf24.spend(SPI_BURST_CALL_CYCLES);
+
+  while (len--) {
+    nrf24.spend(SPI_BURST_CYCLES);
+    nrf24.transfer(*buf++);
+  }
+}
+
+void HalfDuplexSPI::inBurst(uint8_t *buf, uint8_t len) {
+  nrf24.spend(SPI_BURST_CALL_CYCLES);
+
+  while (len--) {
+    nrf24.spend(SPI_BURST_CYCLES);
+    *buf++ = nrf24.transfer(0);
+  }
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+  return *address;
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+  *address = value;
+}
+
+void _delay_ms(double ms) {
+  nrf24.busyDelay(ms * 1000);
+}
+
+void _delay_us(double us) {
+  nrf24.busyDelay(us);
+}
+
+void _delay_loop_2(uint16_t count) {
+  // 4 cycles per iteration, 0 means 65536.
+  nrf24.csnDelay((count ? count : 65536) * 4e6 / MODEL_F_CPU);
+}
+
+void LowPower::startTicks(uint8_t prescaler) {
+  wdt.prescaler = prescaler;
+  wdt.nextTick = wdt.now + period(prescaler);
+  wdt.running = true;
+}
+
+void LowPower::stopTicks(void) {
+  wdt.running = false;
+}
+
+uint8_t LowPower::sleepTick(void) {
+  if (wdt.woken) {
+    wdt.woken = false;
+    return 0;
+  }
+
+  // Periods completed while awake are all counted at once.
+  if (wdt.now < wdt.nextTick) {
+    if (wdt.wakeAt && wdt.wakeAt <= wdt.nextTick) {
+      wdt.now = wdt.wakeAt;
+      wdt.wakeAt = 0;
+      return 0;
+    }
+
+    wdt.now = wdt.nextTick;
+  }
+
+  uint8_t completed = (wdt.now - wdt.nextTick) / period(wdt.prescaler) + 1;
+  wdt.nextTick += completed * period(wdt.prescaler);
+
+  return completed;
+}
+
+void LowPower::sleep(void) {
+  if (wdt.woken) {
+    wdt.woken = false;
+    return;
+  }
+
+  if (wdt.wakeAt) {
+    wdt.now = wdt.wakeAt;
+    wdt.wakeAt = 0;
+  }
+}
+
+void LowPower::wake(void) {
+  wdt.woken = true;
+}
+
+uint32_t LowPower::period(uint8_t prescaler) {
+  return (uint32_t) 16 << prescaler;
+}
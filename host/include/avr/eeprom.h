@@ -0,0 +1,14 @@
+#ifndef SCOUT_RF_HOST_AVR_EEPROM_H
+#define SCOUT_RF_HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+
+/* EEPROM variables are plain RAM on the host, so they start with their initializers like an erased, then programmed
+ * EEPROM would. */
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+
+#endif //SCOUT_RF_HOST_AVR_EEPROM_H
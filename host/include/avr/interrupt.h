@@ -0,0 +1,7 @@
+#ifndef SCOUT_RF_HOST_AVR_INTERRUPT_H
+#define SCOUT_RF_HOST_AVR_INTERRUPT_H
+
+#define sei()
+#define cli()
+
+#endif //SCOUT_RF_HOST_AVR_INTERRUPT_H
@@ -0,0 +1,14 @@
+#ifndef SCOUT_RF_HOST_AVR_IO_H
+#define SCOUT_RF_HOST_AVR_IO_H
+
+/* Host stand-in for <avr/io.h>, just enough of ATtiny85 for lib/radio to compile. */
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t PINB, DDRB, PORTB, PCMSK, GIMSK;
+
+#define PCIE 5
+
+#endif //SCOUT_RF_HOST_AVR_IO_H
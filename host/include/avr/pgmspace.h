@@ -0,0 +1,15 @@
+#ifndef SCOUT_RF_HOST_AVR_PGMSPACE_H
+#define SCOUT_RF_HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Flash and RAM share one address space on the host. */
+
+#define PROGMEM
+
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define memcmp_P memcmp
+#define memcpy_P memcpy
+
+#endif //SCOUT_RF_HOST_AVR_PGMSPACE_H
@@ -0,0 +1,11 @@
+#ifndef SCOUT_RF_HOST_AVR_SLEEP_H
+#define SCOUT_RF_HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_PWR_DOWN 2
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+
+#endif //SCOUT_RF_HOST_AVR_SLEEP_H
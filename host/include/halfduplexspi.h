@@ -0,0 +1,38 @@
+#ifndef SCOUT_RF_HOST_HALFDUPLEXSPI_H
+#define SCOUT_RF_HOST_HALFDUPLEXSPI_H
+
+#include <avr/io.h>
+
+/* Host stand-in for lib/halfduplexspi, bytes go straight to the nRF24L01+ model.
+ *
+ * SCK drives CSN through the RC network on the board, so SCK writes through cbi/sbi are what the model sees as CSN
+ * edges. Every byte is charged the cycles the AVR implementation takes, see nrf24model.h.
+ */
+
+#define SPI_SCK 2
+#define SPI_MOMI 0
+
+#define cbi(x, y)    x &= ~(1 << y)
+#define sbi(x, y)    x |= (1 << y)
+
+class SpiPort {
+public:
+  SpiPort &operator&=(uint8_t mask);
+  SpiPort &operator|=(uint8_t mask);
+};
+
+extern SpiPort spiPort;
+
+#define SPI_PORT spiPort
+
+class HalfDuplexSPI {
+public:
+  static void setup(void);
+  static uint8_t byte(uint8_t);
+  static uint8_t in(void);
+  static void out(uint8_t);
+  static void outBurst(const uint8_t *buf, uint8_t len);
+  static void inBurst(uint8_t *buf, uint8_t len);
+};
+
+#endif //SCOUT_RF_HOST_HALFDUPLEXSPI_H
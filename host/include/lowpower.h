@@ -0,0 +1,32 @@
+#ifndef SCOUT_RF_HOST_LOWPOWER_H
+#define SCOUT_RF_HOST_LOWPOWER_H
+
+#include <avr/io.h>
+
+/* Host stand-in for lib/lowpower, sleeps advance a simulated clock instead of the MCU sleeping.
+ *
+ * WDT periods are nominal and run from startTicks() on, wakeAt plays a pin change interrupt that ends a sleep.
+ */
+
+struct WdtModel {
+  uint32_t now;      /**< Simulated time, in milliseconds */
+  uint32_t nextTick; /**< End of the running period */
+  bool running;
+  uint8_t prescaler;
+  bool woken;        /**< wake() has been called */
+  uint32_t wakeAt;   /**< Next interrupt that ends a sleep, 0 means none */
+};
+
+extern WdtModel wdt;
+
+class LowPower {
+public:
+  static void startTicks(uint8_t prescaler);
+  static void stopTicks(void);
+  static uint8_t sleepTick(void);
+  static void sleep(void);
+  static void wake(void);
+  static uint32_t period(uint8_t prescaler);
+};
+
+#endif //SCOUT_RF_HOST_LOWPOWER_H
@@ -0,0 +1,11 @@
+#ifndef SCOUT_RF_HOST_UTIL_ATOMIC_H
+#define SCOUT_RF_HOST_UTIL_ATOMIC_H
+
+/* Nothing interrupts the host build, atomic blocks run once as they are. */
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#define ATOMIC_BLOCK(type) for (bool _atomicOnce = true; _atomicOnce; _atomicOnce = false)
+
+#endif //SCOUT_RF_HOST_UTIL_ATOMIC_H
@@ -0,0 +1,9 @@
+#ifndef SCOUT_RF_HOST_UTIL_DELAY_H
+#define SCOUT_RF_HOST_UTIL_DELAY_H
+
+/* Busy delays only advance the simulated clock of the nRF24L01+ model. */
+
+void _delay_ms(double ms);
+void _delay_us(double us);
+
+#endif //SCOUT_RF_HOST_UTIL_DELAY_H
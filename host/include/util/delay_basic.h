@@ -0,0 +1,10 @@
+#ifndef SCOUT_RF_HOST_UTIL_DELAY_BASIC_H
+#define SCOUT_RF_HOST_UTIL_DELAY_BASIC_H
+
+#include <stdint.h>
+
+/* Only used for CSN RC delays, accounted as such by the nRF24L01+ model. */
+
+void _delay_loop_2(uint16_t count);
+
+#endif //SCOUT_RF_HOST_UTIL_DELAY_BASIC_H
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Decode the tokenized log records of the scout firmware back into text.
+
+Reads the UART byte stream from a file, a serial device or stdin and looks the tokens up in the message table of
+src/logmessages.h, see lib/log/log.h for the record format. 'M' records of a METRICS build are skipped, their size
+is taken from the enums of lib/metrics/metrics.h. Bytes outside of records are passed through, so plain text from
+other sources still shows up.
+
+    python3 host/logdecode.py /dev/ttyUSB0
+    python3 host/logdecode.py < capture.bin
+"""
+
+import argparse
+import os
+import re
+import sys
+
+MESSAGE = re.compile(r'X\(\s*(\w+)\s*,\s*(LOG_\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+PLACEHOLDER = re.compile(r'\{u(8|16|32)\}')
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+DEFAULT_MESSAGES = os.path.join(ROOT, 'src', 'logmessages.h')
+DEFAULT_METRICS = os.path.join(ROOT, 'lib', 'metrics', 'metrics.h')
+
+
+def load_messages(path):
+    with open(path) as source:
+        return [(token, level[len('LOG_'):], text) for token, level, text in MESSAGE.findall(source.read())]
+
+
+def metrics_record_size(path):
+    """Size of an 'M' record after the marker: awake us, slept ms, u32 per phase, u16 per call and counter."""
+    with open(path) as source:
+        header = source.read()
+
+    def count(name):
+        body = re.search(r'enum %s\s*\{(.*?)\}' % name, header, re.S).group(1)
+        return len([entry for entry in re.findall(r'(\w+)\s*(?:=\s*\w+\s*)?,', body)])
+
+    return 4 + 4 + count('MetricsPhase') * 4 + count('MetricsCall') * count('MetricsCounter') * 2
+
+
+def read_exactly(stream, size):
+    data = stream.read(size)
+    if len(data) < size:
+        raise EOFError
+    return data
+
+
+def decode(stream, messages, metrics_size, out):
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            return
+
+        if byte == b'M':
+            try:
+                read_exactly(stream, metrics_size)
+                out.write('<metrics record>\n')
+            except EOFError:
+                out.write('<truncated metrics record>\n')
+                return
+            continue
+
+        if byte != b'L':
+            out.write(byte.decode('latin-1'))
+            continue
+
+        try:
+            token = read_exactly(stream, 1)[0]
+            if token >= len(messages):
+                out.write('<unknown log token %d>\n' % token)
+                continue
+
+            name, level, text = messages[token]
+
+            def argument(match):
+                size = int(match.group(1)) // 8
+                return str(int.from_bytes(read_exactly(stream, size), 'little'))
+
+            out.write('%-5s %s\n' % (level, PLACEHOLDER.sub(argument, text)))
+        except EOFError:
+            out.write('<truncated log record>\n')
+            return
+        finally:
+            out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', nargs='?', help='capture file or serial device, stdin by default')
+    parser.add_argument('--messages', default=DEFAULT_MESSAGES, help='message table, src/logmessages.h by default')
+    parser.add_argument('--metrics', default=DEFAULT_METRICS, help='metrics enums, lib/metrics/metrics.h by default')
+    args = parser.parse_args()
+
+    messages = load_messages(args.messages)
+    stream = open(args.input, 'rb', buffering=0) if args.input else sys.stdin.buffer
+
+    try:
+        decode(stream, messages, metrics_record_size(args.metrics), sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
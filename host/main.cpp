@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "eventbatch.h"
+#include "lowpower.h"
+#include "network.h"
+#include "nrf24model.h"
+#include "radio.h"
+#include "retrypolicy.h"
+#include "scheduler.h"
+
+/* Host driver: runs the Radio API against the nRF24L01+ model and reports what every call costs the MCU.
+ *
+ * Usage: radio-model [results.json]
+ *
+ * Numbers are deterministic, so results.json of two revisions can be diffed to catch performance regressions
+ * without any hardware attached.
+ */
+
+// Keep in sync with src/main.cpp.
+const uint8_t minRetryDelay = 5;
+
+typedef RadioProfile<25, RATE_250KBPS, HIGH, minRetryDelay, 15, CRC_16, ADDRESS_WIDTH, _BV(ERX_P0), 0b111111,
+    _BV(DPL_P0), true> ScoutProfile;
+
+// Separate PONG packet as before ACK payloads, for comparison.
+typedef RadioProfile<25, RATE_250KBPS, HIGH, 2, 15, CRC_16, ADDRESS_WIDTH, _BV(ERX_P0) | _BV(ERX_P1), 0b111111,
+    _BV(DPL_P0) | _BV(DPL_P1)> ListeningProfile;
+
+const uint8_t nodeId = 1;
+const uint8_t epoch = 0;
+
+const uint8_t rxPipe[5] = {0x71, 0xCD, 0xAB, 0xCD, 0xAB};
+
+const uint32_t timeoutPeriod = 3000;
+
+RetryPolicy retryPolicy(minRetryDelay);
+
+EventBatch events;
+uint8_t frame[EVENT_FRAME_SIZE];
+
+// Model time in ms, edges are a second apart.
+uint32_t now = 0;
+
+/**
+ * Record a few edges, as a light event would, and encode the frame sendPing() would send
+ * @return Frame length
+ */
+uint8_t encodeEdges(uint8_t edges) {
+  for (uint8_t i = 0; i < edges; i++) {
+    now += 1000;
+    events.record(!(i & 1), now);
+  }
+
+  return events.encode(frame, nodeId, epoch, 0, now);
+}
+
+/**
+ * @return Whether the hub has received a valid FRAME_EVENTS frame from the scout last
+ */
+bool isEventFrameReceived(void) {
+  if (nrf24.hubReceived.empty()) {
+    return false;
+  }
+
+  const std::vector<uint8_t> &data = nrf24.hubReceived.back().data;
+  uint32_t header = readFrameHeader(data.data());
+
+  return isFrameValid(header, data.size()) && frameType(header) == FRAME_EVENTS && frameNode(header) == nodeId &&
+         frameEpoch(header) == epoch;
+}
+
+struct Result {
+  std::string name;
+  Nrf24Stats stats;
+};
+
+std::vector<Result> results;
+
+template<typename Operation>
+void measure(const char *name, Operation operation) {
+  Nrf24Stats before = nrf24.stats;
+
+  operation();
+
+  Result result = {name, nrf24.stats - before};
+  results.push_back(result);
+}
+
+/**
+ * One sendPing() round of src/main.cpp, PONG comes back as an ACK payload
+ * @return Whether PONG came back
+ */
+bool pingRound(Radio &radio) {
+  uint8_t rxData[FRAME_HEADER_SIZE] = {0, 0, 0, 0};
+  uint8_t length = events.encode(frame, nodeId, epoch, 0, now);
+
+  radio.openWritingPipe_P(scoutPipe);
+  radio.stopListening();
+  retryPolicy.apply(radio);
+
+  if (!radio.writeFast(frame, length) || !radio.txStandBy()) {
+    retryPolicy.failed();
+    return false;
+  }
+
+  retryPolicy.sent(radio.getRetransmits());
+
+  if (!radio.available()) {
+    return false;
+  }
+
+  radio.read(&rxData, sizeof(rxData));
+
+  return readFrameHeader(rxData) == pongHeader;
+}
+
+/**
+ * sendPing() round as it was before ACK payloads: PING, then RX mode for a separate PONG packet
+ * @return Whether PONG came back
+ */
+bool listeningPingRound(Radio &radio) {
+  uint8_t rxData[FRAME_HEADER_SIZE] = {0, 0, 0, 0};
+  uint8_t length = events.encode(frame, nodeId, epoch, 0, now);
+
+  radio.openWritingPipe_P(scoutPipe);
+  radio.openReadingPipe(rxPipe);
+  radio.stopListening();
+  radio.writeFast(frame, length);
+  radio.txStandBy();
+  radio.startListening();
+
+  uint8_t pipe;
+  if (!radio.available(&pipe) || pipe != 1) {
+    return false;
+  }
+
+  radio.read(&rxData, sizeof(rxData));
+  radio.stopListening();
+
+  return readFrameHeader(rxData) == pongHeader;
+}
+
+/**
+ * Whole ping session, i.e. everything a single light event costs
+ * @return Whether PONG came back
+ */
+bool pingSession(Radio &radio) {
+  bool received = false;
+
+  radio.powerUp();
+
+  for (uint8_t attempt = 0; attempt < retryPolicy.maxAttempts() && !received; attempt++) {
+    received = pingRound(radio);
+  }
+
+  retryPolicy.finished(received);
+
+  if (received) {
+    events.acknowledge();
+  }
+
+  radio.powerDown();
+
+  return received;
+}
+
+/**
+ * Light flickering under the timers of src/main.cpp: the batch timer runs all along, every edge arms the short
+ * debounce timer and edges are stamped with Scheduler::now()
+ * @return Whether edges 500ms apart encode as about 8 EVENT_TICK_MS apart
+ */
+bool flickerTicks(void) {
+  const Event flush = 0, debounce = 1;
+  const uint8_t edges = 8;
+  EventBatch batch;
+  uint8_t data[EVENT_FRAME_SIZE];
+  uint32_t start = wdt.now;
+  Event event;
+
+  Scheduler::setTimer(0, 30000, flush);
+
+  for (uint8_t i = 1; i <= edges; i++) {
+    wdt.wakeAt = start + 500 * i;
+    while (wdt.wakeAt) {
+      Scheduler::sleep();
+      while (Scheduler::next(event));
+    }
+
+    batch.record(i & 1, Scheduler::now());
+    Scheduler::setTimer(1, 16, debounce);
+  }
+
+  Scheduler::cancelTimer(0);
+  Scheduler::cancelTimer(1);
+
+  uint8_t length = batch.encode(data, 1, 0, 0, Scheduler::now());
+  bool ok = length == FRAME_HEADER_SIZE + EVENT_HEADER_SIZE + edges;
+
+  for (uint8_t i = 1; i < edges && ok; i++) {
+    uint8_t delta = data[FRAME_HEADER_SIZE + EVENT_HEADER_SIZE + i] & 0x7f;
+    ok = delta >= 7 && delta <= 8;
+  }
+
+  return ok;
+}
+
+void print(void) {
+  printf("%-28s %6s %6s %10s %10s %10s %10s %10s\n", "operation", "trans", "bytes", "spi us", "csn us", "busy us",
+         "total ms", "air us");
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const Nrf24Stats &stats = results[i].stats;
+
+    printf("%-28s %6u %6u %10.1f %10.1f %10.1f %10.3f %10.1f\n", results[i].name.c_str(), stats.transactions,
+           stats.bytes, stats.spiUs, stats.csnDelayUs, stats.busyDelayUs, stats.mcuUs() / 1000, stats.airUs);
+  }
+}
+
+bool save(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  fprintf(file, "{\n");
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const Nrf24Stats &stats = results[i].stats;
+
+    fprintf(file,
+            "  \"%s\": {\"transactions\": %u, \"bytes\": %u, \"spi_us\": %.1f, \"csn_delay_us\": %.1f, "
+                "\"busy_delay_us\": %.1f, \"total_us\": %.1f, \"air_us\": %.1f}%s\n",
+            results[i].name.c_str(), stats.transactions, stats.bytes, stats.spiUs, stats.csnDelayUs,
+            stats.busyDelayUs, stats.mcuUs(), stats.airUs, i + 1 < results.size() ? "," : "");
+  }
+
+  fprintf(file, "}\n");
+  fclose(file);
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Radio radio;
+  bool ok = true;
+  uint8_t buf[32];
+  uint8_t length = encodeEdges(4);
+
+  measure("setup<ScoutProfile>", [&] { ok &= radio.setup<ScoutProfile>(); });
+  measure("setup", [&] { ok &= radio.setup(); });
+  measure("setup<ScoutProfile> again", [&] { ok &= radio.setup<ScoutProfile>(); });
+  measure("verify", [&] { ok &= radio.verify(); });
+  measure("resync", [&] { radio.resync(); });
+  measure("get_status", [&] { radio.get_status(); });
+  measure("read_register", [&] { radio.read_register(RF_SETUP); });
+  measure("write_register", [&] { radio.write_register(RF_CH, 25); });
+  measure("read_register 5B", [&] { radio.read_register(TX_ADDR, buf, 5); });
+  measure("write_register 5B", [&] { radio.write_register(TX_ADDR, scoutPipe, 5); });
+  measure("setChannel unchanged", [&] { radio.setChannel(25); });
+  measure("setRetries", [&] { radio.setRetries(3, 15); });
+  measure("setOutputPower", [&] { radio.setOutputPower(MAX); });
+  measure("setDataRate", [&] { ok &= radio.setDataRate(RATE_250KBPS); });
+  measure("powerDown", [&] { radio.powerDown(); });
+  measure("powerUp", [&] { radio.powerUp(); });
+  measure("openWritingPipe", [&] { radio.openWritingPipe(scoutPipe); });
+  measure("openWritingPipe unchanged", [&] { radio.openWritingPipe(scoutPipe); });
+  measure("openWritingPipe_P unchanged", [&] { radio.openWritingPipe_P(scoutPipe); });
+  measure("openReadingPipe", [&] { radio.openReadingPipe(rxPipe); });
+  measure("openReadingPipe 2", [&] { radio.openReadingPipe(2, rxPipe); });
+  measure("setPayloadSize", [&] { radio.setPayloadSize(2, 5); });
+  measure("closeReadingPipe", [&] { radio.closeReadingPipe(2); });
+  measure("startListening", [&] { radio.startListening(); });
+  measure("available", [&] { radio.available(); });
+  measure("stopListening", [&] { radio.stopListening(); });
+  measure("stopListening again", [&] { radio.stopListening(); });
+  measure("writeFast", [&] { ok &= radio.writeFast(frame, length); });
+  measure("txStandBy", [&] { ok &= radio.txStandBy(); });
+  measure("writeBlocking", [&] { ok &= radio.writeBlocking(frame, length, timeoutPeriod); });
+
+  uint8_t occupancy[CHANNEL_MAP_SIZE];
+  uint8_t channels[] = HUB_CHANNELS;
+  nrf24.busyChannels.push_back(25);
+  nrf24.busyChannels.push_back(76);
+  measure("surveyChannels", [&] { radio.surveyChannels(occupancy, 8); });
+  Radio::rankChannels(occupancy, channels, sizeof(channels));
+  ok &= channels[0] == 50 && channels[1] == 80 && Radio::channelOccupancy(occupancy, 76) == 8;
+  ok &= nrf24.registerValue(RF_CH) == 25 && !(nrf24.registerValue(CONFIG) & _BV(PRIM_RX));
+
+  ok &= isEventFrameReceived() && nrf24.hubReceived.back().data.size() == length;
+  events.acknowledge();
+
+  nrf24.hubReply.assign(pong, pong + sizeof(pong));
+  radio.setup<ScoutProfile>();
+  radio.enablePowerControl();
+  radio.powerDown();
+  encodeEdges(4);
+  measure("sendPing round", [&] { radio.powerUp(); ok &= pingRound(radio); });
+  ok &= isEventFrameReceived();
+  radio.powerDown();
+
+  radio.setup<ListeningProfile>();
+  measure("sendPing round, PONG packet", [&] { ok &= listeningPingRound(radio); });
+  radio.setup<ScoutProfile>();
+  radio.enablePowerControl();
+  radio.powerDown();
+  encodeEdges(4);
+  measure("ping session, hub answers", [&] { ok &= pingSession(radio); });
+  ok &= isEventFrameReceived();
+
+  length = encodeEdges(4);
+  const void *payloads[] = {frame, frame, frame, frame, frame, frame};
+  const uint8_t lengths[] = {length, length, length, length, length, length};
+  radio.powerUp();
+  nrf24.hubReply.clear();
+  measure("writeMany 6", [&] { ok &= radio.writeMany(payloads, lengths, 6) == 0b111111; });
+  measure("6 x writeFast + txStandBy", [&] {
+    for (uint8_t i = 0; i < 6; i++) {
+      ok &= radio.writeFast(frame, length) && radio.txStandBy();
+    }
+  });
+  nrf24.hubPresent = false;
+  measure("writeMany 6, no hub", [&] { ok &= radio.writeMany(payloads, lengths, 6) == 0; });
+  radio.setup<ScoutProfile>();
+  radio.powerDown();
+  nrf24.hubReply.assign(pong, pong + sizeof(pong));
+  events.acknowledge();
+  encodeEdges(4);
+
+  measure("ping session, no hub", [&] { ok &= !pingSession(radio); });
+  measure("ping session, no hub again", [&] { ok &= !pingSession(radio); });
+
+  // First ACK on a channel stores the level. No hub on the next one raises the power only until the channel after,
+  // and none of it makes it to EEPROM.
+  radio.enablePowerControl();
+  radio.setOutputPower(LOW);
+  nrf24.hubPresent = true;
+  ok &= pingSession(radio);
+  nrf24.hubPresent = false;
+  radio.setChannel(50);
+  ok &= !pingSession(radio) && radio.getOutputPower() == MAX;
+  radio.setChannel(76);
+  ok &= radio.getOutputPower() == LOW;
+  radio.enablePowerControl();
+  ok &= radio.getOutputPower() == LOW;
+
+  ok &= flickerTicks();
+
+  print();
+
+  if (argc > 1 && !save(argv[1])) {
+    return 2;
+  }
+
+  if (!ok) {
+    fprintf(stderr, "Radio didn't behave as expected against the model\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,305 @@
+#include <avr/io.h>
+#include <string.h>
+#include <algorithm>
+
+#include "nRF24L01.h"
+#include "nrf24model.h"
+
+Nrf24Model nrf24;
+
+static const uint8_t FIFO_SIZE = 3;
+static const uint8_t PAYLOAD_SIZE = 32;
+
+double Nrf24Stats::mcuUs(void) const {
+  return spiUs + csnDelayUs + busyDelayUs;
+}
+
+Nrf24Stats Nrf24Stats::operator-(const Nrf24Stats &other) const {
+  Nrf24Stats result;
+
+  result.transactions = transactions - other.transactions;
+  result.bytes = bytes - other.bytes;
+  result.spiUs = spiUs - other.spiUs;
+  result.csnDelayUs = csnDelayUs - other.csnDelayUs;
+  result.busyDelayUs = busyDelayUs - other.busyDelayUs;
+  result.airUs = airUs - other.airUs;
+
+  return result;
+}
+
+Nrf24Model::Nrf24Model(void) : hubPresent(true), stats() {
+  reset();
+}
+
+void Nrf24Model::reset(void) {
+  memset(registers, 0, sizeof(registers));
+
+  registers[CONFIG] = _BV(EN_CRC);
+  registers[EN_AA] = 0b111111;
+  registers[EN_RXADDR] = _BV(ERX_P0) | _BV(ERX_P1);
+  registers[SETUP_AW] = 0b11;
+  registers[SETUP_RETR] = 0b11;
+  registers[RF_CH] = 2;
+  registers[RF_SETUP] = 0b1110;
+  registers[STATUS] = 0;
+
+  memset(addresses[0], 0xE7, 5);
+  memset(addresses[1], 0xC2, 5);
+  for (uint8_t pipe = 2; pipe < 6; pipe++) {
+    memset(addresses[pipe], 0xC2, 5);
+    addresses[pipe][0] = 0xC1 + pipe;
+  }
+  memset(addresses[6], 0xE7, 5);
+
+  txFifo.clear();
+  rxFifo.clear();
+  hubPending.clear();
+
+  selected = false;
+}
+
+void Nrf24Model::csnLow(void) {
+  if (selected) {
+    return;
+  }
+
+  selected = true;
+  commandPhase = true;
+  index = 0;
+  incoming.clear();
+
+  stats.transactions++;
+}
+
+void Nrf24Model::csnHigh(void) {
+  if (!selected) {
+    return;
+  }
+
+  selected = false;
+
+  if (commandPhase) {
+    return;
+  }
+
+  if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NO_ACK) {
+    if (txFifo.size() < FIFO_SIZE && !incoming.empty()) {
+      Nrf24Packet packet = {incoming, 0, command == W_TX_PAYLOAD_NO_ACK};
+      txFifo.push_back(packet);
+    }
+  } else if ((command & ~0b111) == W_ACK_PAYLOAD) {
+    // ACK payloads are only meaningful for a hub, the scout model doesn't act as one.
+  } else if (command == R_RX_PAYLOAD && index && !rxFifo.empty()) {
+    rxFifo.pop_front();
+  }
+
+  process();
+}
+
+uint8_t Nrf24Model::transfer(uint8_t mosi) {
+  stats.bytes++;
+
+  if (!selected) {
+    return 0xFF;
+  }
+
+  if (commandPhase) {
+    uint8_t result = status();
+
+    command = mosi;
+    commandPhase = false;
+
+    if (command == FLUSH_TX) {
+      txFifo.clear();
+    } else if (command == FLUSH_RX) {
+      rxFifo.clear();
+    }
+
+    return result;
+  }
+
+  uint8_t at = index++;
+
+  if ((command & ~REGISTER_MASK) == R_REGISTER) {
+    return readRegister(command & REGISTER_MASK, at);
+  }
+
+  if ((command & ~REGISTER_MASK) == W_REGISTER) {
+    writeRegister(command & REGISTER_MASK, at, mosi);
+    return 0;
+  }
+
+  if (command == R_RX_PL_WID) {
+    return rxFifo.empty() ? 0 : rxFifo.front().data.size();
+  }
+
+  if (command == R_RX_PAYLOAD) {
+    if (rxFifo.empty() || at >= rxFifo.front().data.size()) {
+      return 0;
+    }
+
+    return rxFifo.front().data[at];
+  }
+
+  if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NO_ACK || (command & ~0b111) == W_ACK_PAYLOAD) {
+    if (incoming.size() < PAYLOAD_SIZE) {
+      incoming.push_back(mosi);
+    }
+  }
+
+  return 0;
+}
+
+void Nrf24Model::spend(uint32_t cycles) {
+  stats.spiUs += cycles * 1e6 / MODEL_F_CPU;
+}
+
+void Nrf24Model::csnDelay(double us) {
+  stats.csnDelayUs += us;
+  process();
+}
+
+void Nrf24Model::busyDelay(double us) {
+  stats.busyDelayUs += us;
+  process();
+}
+
+uint8_t Nrf24Model::registerValue(uint8_t reg) const {
+  return readRegister(reg, 0);
+}
+
+uint8_t Nrf24Model::status(void) const {
+  uint8_t pipe = rxFifo.empty() ? 0b111 : rxFifo.front().pipe;
+
+  return (registers[STATUS] & (_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT))) | pipe << RX_P_NO |
+         (txFifo.size() == FIFO_SIZE ? _BV(TX_FULL) : 0);
+}
+
+uint8_t Nrf24Model::fifoStatus(void) const {
+  return (txFifo.size() == FIFO_SIZE ? _BV(FIFO_FULL) : 0) | (txFifo.empty() ? _BV(TX_EMPTY) : 0) |
+         (rxFifo.size() == FIFO_SIZE ? _BV(RX_FULL) : 0) | (rxFifo.empty() ? _BV(RX_EMPTY) : 0);
+}
+
+uint8_t Nrf24Model::addressWidth(void) const {
+  return (registers[SETUP_AW] & 0b11) + 2;
+}
+
+uint8_t Nrf24Model::readRegister(uint8_t reg, uint8_t index) const {
+  if (reg == STATUS) {
+    return status();
+  }
+
+  if (reg == FIFO_STATUS) {
+    return fifoStatus();
+  }
+
+  if (reg == RPD) {
+    bool listening = (registers[CONFIG] & (_BV(PWR_UP) | _BV(PRIM_RX))) == (_BV(PWR_UP) | _BV(PRIM_RX));
+    return listening && std::find(busyChannels.begin(), busyChannels.end(), registers[RF_CH]) != busyChannels.end();
+  }
+
+  if (reg >= RX_ADDR_P0 && reg <= TX_ADDR) {
+    bool wide = reg == RX_ADDR_P0 || reg == RX_ADDR_P1 || reg == TX_ADDR;
+    return index < (wide ? addressWidth() : 1) ? addresses[reg - RX_ADDR_P0][index] : 0;
+  }
+
+  return index ? 0 : registers[reg];
+}
+
+void Nrf24Model::writeRegister(uint8_t reg, uint8_t index, uint8_t value) {
+  if (reg >= RX_ADDR_P0 && reg <= TX_ADDR) {
+    bool wide = reg == RX_ADDR_P0 || reg == RX_ADDR_P1 || reg == TX_ADDR;
+    if (index < (wide ? addressWidth() : 1)) {
+      addresses[reg - RX_ADDR_P0][index] = value;
+    }
+    return;
+  }
+
+  if (index) {
+    return;
+  }
+
+  if (reg == STATUS) {
+    // Flags are cleared by writing 1.
+    registers[STATUS] &= ~(value & (_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT)));
+  } else if (reg != FIFO_STATUS && reg != OBSERVE_TX && reg != RPD) {
+    registers[reg] = value;
+  }
+}
+
+void Nrf24Model::receive(const std::vector<uint8_t> &data, uint8_t pipe) {
+  if (rxFifo.size() == FIFO_SIZE) {
+    return;
+  }
+
+  Nrf24Packet packet = {data, pipe, false};
+
+  // Without dynamic payload length the receiver takes exactly RX_PW_Px bytes.
+  if (!((registers[FEATURE] & _BV(EN_DPL)) && (registers[DYNPD] & _BV(pipe)))) {
+    packet.data.resize(registers[RX_PW_P0 + pipe]);
+  }
+
+  rxFifo.push_back(packet);
+  registers[STATUS] |= _BV(RX_DR);
+}
+
+double Nrf24Model::airtime(uint8_t length) const {
+  uint8_t setup = registers[RF_SETUP];
+  double bitUs = setup & _BV(RF_DR_LOW) ? 4 : setup & _BV(RF_DR_HIGH) ? 0.5 : 1;
+  uint8_t crc = registers[CONFIG] & _BV(EN_CRC) ? (registers[CONFIG] & _BV(CRCO) ? 2 : 1) : 0;
+
+  // Preamble, address, 9-bit packet control field, payload and CRC, plus 130us PLL settling.
+  return 130 + bitUs * (8 * (1 + addressWidth() + length + crc) + 9);
+}
+
+void Nrf24Model::process(void) {
+  if (!(registers[CONFIG] & _BV(PWR_UP))) {
+    return;
+  }
+
+  if (registers[CONFIG] & _BV(PRIM_RX)) {
+    while (!hubPending.empty() && rxFifo.size() < FIFO_SIZE) {
+      stats.airUs += airtime(hubPending.front().size());
+      receive(hubPending.front(), 1);
+      hubPending.pop_front();
+    }
+    return;
+  }
+
+  // PTX halts while MAX_RT is set.
+  while (!txFifo.empty() && !(registers[STATUS] & _BV(MAX_RT))) {
+    Nrf24Packet &packet = txFifo.front();
+    bool ack = !packet.noAck && (registers[EN_AA] & _BV(ENAA_P0));
+    uint8_t retries = registers[SETUP_RETR] >> ARC & 0xf;
+    double retryDelay = 250.0 * ((registers[SETUP_RETR] >> ARD & 0xf) + 1);
+
+    if (ack && !hubPresent) {
+      stats.airUs += (retries + 1) * airtime(packet.data.size()) + retries * retryDelay;
+
+      uint8_t lost = (registers[OBSERVE_TX] >> PLOS_CNT) + 1;
+      registers[OBSERVE_TX] = (lost > 15 ? 15 : lost) << PLOS_CNT | retries << ARC_CNT;
+      registers[STATUS] |= _BV(MAX_RT);
+      break;
+    }
+
+    // ACK payloads need dynamic payload length on pipe 0.
+    bool ackPayload = ack && hubPresent && !hubReply.empty() && (registers[FEATURE] & _BV(EN_ACK_PAY)) &&
+                      (registers[DYNPD] & _BV(DPL_P0));
+
+    stats.airUs += airtime(packet.data.size()) + (ack ? airtime(ackPayload ? hubReply.size() : 0) : 0);
+    registers[OBSERVE_TX] &= ~(0xf << ARC_CNT);
+
+    if (hubPresent) {
+      hubReceived.push_back(packet);
+
+      if (ackPayload) {
+        receive(hubReply, 0);
+      } else if (!hubReply.empty()) {
+        hubPending.push_back(hubReply);
+      }
+    }
+
+    txFifo.pop_front();
+    registers[STATUS] |= _BV(TX_DS);
+  }
+}
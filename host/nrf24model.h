@@ -0,0 +1,124 @@
+#ifndef SCOUT_RF_NRF24MODEL_H
+#define SCOUT_RF_NRF24MODEL_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+/* Behavioral nRF24L01+ model for the host build of lib/radio
+ *
+ * Covers the register map, the 3-level TX and RX FIFOs, STATUS/FIFO_STATUS flags, dynamic payload length and auto-ack
+ * against a simulated hub. CE is tied high as in the 3-pin wiring, so a powered up PTX transmits as soon as its TX
+ * FIFO has data, and a powered up PRX receives whatever the hub has queued.
+ *
+ * The model also keeps the MCU side cost: SPI transactions and bytes, time spent clocking bytes, in CSN RC delays and
+ * in busy delays. Transmissions complete instantly from the MCU point of view, their airtime is accounted separately.
+ */
+
+// MCU clock the SPI cycle costs are converted with.
+static const uint32_t MODEL_F_CPU = 8000000;
+
+// AVR cycles per byte of lib/halfduplexspi, estimated from the code. Replace with bench/results.json numbers.
+static const uint16_t SPI_BYTE_CYCLES = 140;
+static const uint16_t SPI_IN_CYCLES = 100;
+static const uint16_t SPI_OUT_CYCLES = 100;
+static const uint16_t SPI_BURST_CYCLES = 77;
+static const uint16_t SPI_BURST_CALL_CYCLES = 12;
+
+struct Nrf24Stats {
+  uint32_t transactions;
+  uint32_t bytes;
+  double spiUs;
+  double csnDelayUs;
+  double busyDelayUs;
+  double airUs;
+
+  /**
+   * MCU time, i.e. everything but airtime
+   */
+  double mcuUs(void) const;
+
+  Nrf24Stats operator-(const Nrf24Stats &other) const;
+};
+
+struct Nrf24Packet {
+  std::vector<uint8_t> data;
+  uint8_t pipe;
+  bool noAck;
+};
+
+class Nrf24Model {
+public:
+  Nrf24Model(void);
+
+  /**
+   * Power-on reset, statistics are kept
+   */
+  void reset(void);
+
+  void csnLow(void);
+  void csnHigh(void);
+  uint8_t transfer(uint8_t mosi);
+
+  void spend(uint32_t cycles);
+  void csnDelay(double us);
+  void busyDelay(double us);
+
+  /**
+   * Whether the hub is in range and acknowledges payloads
+   */
+  bool hubPresent;
+
+  /**
+   * Payload the hub sends back for every payload it receives, as an ACK payload if the scout enabled them and as a
+   * separate packet to the scout's pipe 1 otherwise. Empty means no reply.
+   */
+  std::vector<uint8_t> hubReply;
+
+  /**
+   * Channels with a carrier above the RPD threshold
+   */
+  std::vector<uint8_t> busyChannels;
+
+  /**
+   * Payloads received by the hub
+   */
+  std::vector<Nrf24Packet> hubReceived;
+
+  Nrf24Stats stats;
+
+  uint8_t registerValue(uint8_t reg) const;
+
+private:
+  uint8_t registers[0x20];
+  uint8_t addresses[7][5]; /**< RX_ADDR_P0-P5 and TX_ADDR */
+
+  std::deque<Nrf24Packet> txFifo;
+  std::deque<Nrf24Packet> rxFifo;
+  std::deque<std::vector<uint8_t> > hubPending;
+
+  bool selected;
+  bool commandPhase;
+  uint8_t command;
+  uint8_t index;
+  std::vector<uint8_t> incoming;
+
+  uint8_t status(void) const;
+  uint8_t fifoStatus(void) const;
+  uint8_t addressWidth(void) const;
+
+  uint8_t readRegister(uint8_t reg, uint8_t index) const;
+  void writeRegister(uint8_t reg, uint8_t index, uint8_t value);
+
+  void receive(const std::vector<uint8_t> &data, uint8_t pipe);
+  double airtime(uint8_t length) const;
+
+  /**
+   * Let the radio do whatever its current mode implies, called after every transaction and delay
+   */
+  void process(void);
+};
+
+extern Nrf24Model nrf24;
+
+#endif //SCOUT_RF_NRF24MODEL_H
@@ -0,0 +1,12 @@
+#!/bin/sh
+# Builds the host radio model and writes per-call SPI and delay costs to host/results.json (or the path given as the
+# first argument). Compare the file before and after a change to radio code, no hardware needed.
+set -e
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+results="${1:-$root/host/results.json}"
+
+cmake -S "$root/host" -B "$root/host/build"
+cmake --build "$root/host/build"
+
+"$root/host/build/radio-model" "$results"
@@ -0,0 +1,82 @@
+#include <string.h>
+
+#include "eventbatch.h"
+
+static const uint8_t DELTA_MASK = 0x7f;
+
+EventBatch::EventBatch(void)
+    : length(0), count(0), last(0), overflow(false), sequence(0), encoded(false), encodedLength(0), encodedCount(0), encodedLast(0) {
+}
+
+bool EventBatch::record(bool on, uint32_t time) {
+  if (full() || count == 0xff) {
+    overflow = true;
+    return false;
+  }
+
+  // First edge of a batch has nothing to be relative to, the receiver only anchors on the last one.
+  uint32_t delta = count ? (time - last) / EVENT_TICK_MS : 0;
+  last = time;
+
+  if (delta < DELTA_MASK) {
+    edges[length++] = (on ? 0x80 : 0) | delta;
+  } else {
+    edges[length++] = (on ? 0x80 : 0) | DELTA_MASK;
+    delta -= DELTA_MASK;
+
+    while (delta > DELTA_MASK) {
+      edges[length++] = 0x80 | (delta & DELTA_MASK);
+      delta >>= 7;
+    }
+
+    edges[length++] = delta;
+  }
+
+  count++;
+
+  return true;
+}
+
+bool EventBatch::empty(void) const {
+  return !count;
+}
+
+bool EventBatch::full(void) const {
+  return length > EVENT_BATCH_SIZE - EVENT_MAX_SIZE;
+}
+
+uint8_t EventBatch::encode(uint8_t *frame, uint8_t node, uint8_t epoch, uint8_t flags, uint32_t time) {
+  // New frame only once the previous one has been delivered.
+  if (!encoded) {
+    encoded = true;
+    sequence++;
+    encodedLength = length;
+    encodedCount = count;
+    encodedLast = last;
+  }
+
+  uint32_t age = encodedCount ? (time - encodedLast) / EVENT_TICK_MS : 0;
+  age = age > 0xffff ? 0xffff : age;
+
+  uint8_t *payload = frame + FRAME_HEADER_SIZE;
+  uint8_t payloadLength = EVENT_HEADER_SIZE + encodedLength;
+
+  writeFrameHeader(frame, frameHeader(node, sequence, FRAME_EVENTS, flags | (overflow ? EVENT_FLAG_OVERFLOW : 0),
+                                      payloadLength, epoch));
+  payload[0] = encodedCount;
+  payload[1] = age;
+  payload[2] = age >> 8;
+  memcpy(payload + EVENT_HEADER_SIZE, edges, encodedLength);
+
+  return FRAME_HEADER_SIZE + payloadLength;
+}
+
+void EventBatch::acknowledge(void) {
+  length -= encodedLength;
+  count -= encodedCount;
+  memmove(edges, edges + encodedLength, length);
+
+  overflow = false;
+  encoded = false;
+  encodedLength = encodedCount = 0;
+}
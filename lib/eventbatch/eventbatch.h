@@ -0,0 +1,98 @@
+#ifndef SCOUT_RF_EVENTBATCH_H
+#define SCOUT_RF_EVENTBATCH_H
+
+#include <avr/io.h>
+#include "frame.h"
+
+/* Light edges batched into a single payload
+ *
+ * Every edge takes a byte: the new light state in bit 7 and the time since the previous edge in EVENT_TICK_MS
+ * units in bits 0-6. 127 means the delta goes on in the following bytes, 7 bits each from the least significant
+ * ones, bit 7 set on all but the last. Flicker therefore costs a byte per edge, and only an edge after a long quiet
+ * period takes more.
+ *
+ * encode() produces a FRAME_EVENTS frame with EventFlag flags and the payload:
+ *   edge count, age of the last edge in EVENT_TICK_MS units (u16, little endian), edges
+ *
+ * The receiver anchors the last edge at reception time minus its age and walks the deltas back from there, so the
+ * scout doesn't need an absolute clock.
+ */
+
+// Resolution of timestamps, power of 2.
+#ifndef EVENT_TICK_MS
+#define EVENT_TICK_MS 64
+#endif
+
+// Whole frame has to fit into a payload.
+#define EVENT_FRAME_SIZE (FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE)
+#define EVENT_HEADER_SIZE 3
+#define EVENT_BATCH_SIZE (FRAME_PAYLOAD_SIZE - EVENT_HEADER_SIZE)
+
+// Longest encoded edge: a byte plus a 25-bit delta continuation.
+#define EVENT_MAX_SIZE 5
+
+enum EventFlag {
+  EVENT_FLAG_LIGHT = _BV(0),    /**< Light is on at the time of encode() */
+  EVENT_FLAG_PRIORITY = _BV(1), /**< Flushed because of a priority event, e.g. panic */
+  EVENT_FLAG_OVERFLOW = _BV(2)  /**< Edges have been dropped since the last delivered frame */
+};
+
+class EventBatch {
+public:
+  EventBatch(void);
+
+  /**
+   * Append an edge
+   *
+   * @param on New light state
+   * @param time Time of the edge in ms, see Scheduler::now()
+   * @return False if the batch is full and the edge has been dropped
+   */
+  bool record(bool on, uint32_t time);
+
+  /**
+   * @return True if there are no edges waiting
+   */
+  bool empty(void) const;
+
+  /**
+   * @return True if the next edge may not fit
+   */
+  bool full(void) const;
+
+  /**
+   * Write a frame with the edges recorded so far
+   *
+   * Edges of an encoded frame are set until acknowledge(), encoding again for another attempt gives the same
+   * sequence number and edges, only the age and flags are current. The hub tells a retransmit from new edges that
+   * way, edges recorded meanwhile wait for the next frame.
+   *
+   * @param frame EVENT_FRAME_SIZE bytes
+   * @param node Node id of the sender
+   * @param epoch Epoch of the sender, changes with every reset, see frame.h
+   * @param flags EventFlag bits besides EVENT_FLAG_OVERFLOW, which is added by the batch
+   * @param time Current time in ms, see Scheduler::now()
+   * @return Frame length in bytes
+   */
+  uint8_t encode(uint8_t *frame, uint8_t node, uint8_t epoch, uint8_t flags, uint32_t time);
+
+  /**
+   * Drop the edges of the encoded frame, once it's been delivered
+   */
+  void acknowledge(void);
+
+private:
+  uint8_t edges[EVENT_BATCH_SIZE];
+  uint8_t length;
+  uint8_t count;
+  uint32_t last;      /**< Time of the last edge, in ms */
+  bool overflow;
+
+  uint8_t sequence;    /**< Sequence number of the encoded frame */
+  bool encoded;          /**< A frame is waiting for acknowledge() */
+  uint8_t encodedLength; /**< Edges of the encoded frame */
+  uint8_t encodedCount;
+  uint32_t encodedLast;
+};
+
+#endif //SCOUT_RF_EVENTBATCH_H
@@ -0,0 +1,54 @@
+#include "frame.h"
+
+// Sequence numbers remembered per node besides the highest one, one bit each.
+static const uint8_t WINDOW = 8;
+
+SequenceWindow::SequenceWindow(void) : known(0) {
+}
+
+bool SequenceWindow::accept(uint8_t node, uint8_t epoch, uint8_t sequence) {
+  if (!node || node > SEQUENCE_NODES) {
+    return true;
+  }
+
+  uint8_t slot = node - 1;
+
+  // Node has been reset, the previous run's numbers don't count.
+  if (!(known & _BV(slot)) || epochs[slot] != epoch) {
+    known |= _BV(slot);
+    epochs[slot] = epoch;
+    highest[slot] = sequence;
+    seen[slot] = 0;
+    return true;
+  }
+
+  // Sequence numbers wrap, anything up to half the range ahead is new.
+  uint8_t ahead = sequence - highest[slot];
+
+  if (!ahead) {
+    return false;
+  }
+
+  if (ahead < 0x80) {
+    seen[slot] = ahead > WINDOW ? 0 : (seen[slot] << 1 | 1) << (ahead - 1);
+    highest[slot] = sequence;
+    return true;
+  }
+
+  uint8_t behind = highest[slot] - sequence - 1;
+
+  if (behind >= WINDOW) {
+    // Out of sight, e.g. reset twice within the same epoch, start over.
+    highest[slot] = sequence;
+    seen[slot] = 0;
+    return true;
+  }
+
+  if (seen[slot] & _BV(behind)) {
+    return false;
+  }
+
+  seen[slot] |= _BV(behind);
+
+  return true;
+}
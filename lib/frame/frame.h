@@ -0,0 +1,134 @@
+#ifndef SCOUT_RF_FRAME_H
+#define SCOUT_RF_FRAME_H
+
+#include <avr/io.h>
+
+/* Binary frame shared by scouts and the hub
+ *
+ * 4-byte header followed by up to 28 bytes of payload, so a frame fits a single nRF24L01+ payload:
+ *   node id, sequence number, type (high nibble) | type specific flags (low nibble),
+ *   epoch (bits 5-7) | payload length (bits 0-4)
+ *
+ * The epoch changes with every reset of the sender, so the receiver can tell a fresh sequence from a replayed one.
+ *
+ * The header is handled as a little endian uint32_t built and taken apart by constexpr helpers, so constant frames
+ * like the hub's PONG are computed at compile time.
+ *
+ * @code
+ * writeFrameHeader(frame, frameHeader(NODE_ID, sequence++, FRAME_EVENTS, flags, length, epoch));
+ *
+ * uint32_t header = readFrameHeader(frame);
+ * if (isFrameValid(header, received) && frameType(header) == FRAME_EVENTS) {
+ *   ...
+ * }
+ * @endcode
+ */
+
+static const uint8_t FRAME_HEADER_SIZE = 4;
+static const uint8_t FRAME_PAYLOAD_SIZE = 32 - FRAME_HEADER_SIZE;
+
+// Epochs wrap around, a sender only has to differ from its previous run.
+static const uint8_t FRAME_EPOCHS = 8;
+
+// Node id of the hub, scouts take 1-255.
+static const uint8_t HUB_NODE = 0;
+
+enum FrameType {
+  FRAME_PONG = 0,   /**< Hub's ACK payload, no payload of its own */
+  FRAME_EVENTS = 1  /**< EventBatch payload, flags are EventFlag */
+};
+
+constexpr uint32_t frameHeader(uint8_t node, uint8_t sequence, FrameType type, uint8_t flags, uint8_t length,
+                               uint8_t epoch = 0) {
+  return (uint32_t) node | (uint32_t) sequence << 8 | (uint32_t) (type << 4 | (flags & 0xf)) << 16 |
+         (uint32_t) ((epoch & (FRAME_EPOCHS - 1)) << 5 | (length & 0x1f)) << 24;
+}
+
+constexpr uint8_t frameNode(uint32_t header) {
+  return header;
+}
+
+constexpr uint8_t frameSequence(uint32_t header) {
+  return header >> 8;
+}
+
+constexpr FrameType frameType(uint32_t header) {
+  return (FrameType) (header >> 20 & 0xf);
+}
+
+constexpr uint8_t frameFlags(uint32_t header) {
+  return header >> 16 & 0xf;
+}
+
+constexpr uint8_t frameLength(uint32_t header) {
+  return header >> 24 & 0x1f;
+}
+
+constexpr uint8_t frameEpoch(uint32_t header) {
+  return header >> 29;
+}
+
+/**
+ * @param header Frame header
+ * @param index 0-3
+ * @return Byte @p index of the header as sent over the air
+ */
+constexpr uint8_t frameByte(uint32_t header, uint8_t index) {
+  return header >> (index << 3);
+}
+
+/**
+ * @param header Frame header
+ * @param received Number of bytes received, header included
+ * @return True if the header length matches what has been received
+ */
+constexpr bool isFrameValid(uint32_t header, uint8_t received) {
+  return received >= FRAME_HEADER_SIZE && frameLength(header) == received - FRAME_HEADER_SIZE &&
+         frameLength(header) <= FRAME_PAYLOAD_SIZE;
+}
+
+inline void writeFrameHeader(uint8_t *frame, uint32_t header) {
+  frame[0] = frameByte(header, 0);
+  frame[1] = frameByte(header, 1);
+  frame[2] = frameByte(header, 2);
+  frame[3] = frameByte(header, 3);
+}
+
+inline uint32_t readFrameHeader(const uint8_t *frame) {
+  return (uint32_t) frame[0] | (uint32_t) frame[1] << 8 | (uint32_t) frame[2] << 16 | (uint32_t) frame[3] << 24;
+}
+
+/* Duplicate suppression for up to SEQUENCE_NODES nodes, ids 1 to SEQUENCE_NODES
+ *
+ * Keeps the highest sequence number seen per node and which of the 8 numbers before it have been seen too. Anything
+ * seen before is a duplicate, i.e. a retransmit whose ACK got lost. A new epoch means the node has been reset and
+ * starts the window over, so does a number further back than the window.
+ */
+#ifndef SEQUENCE_NODES
+#define SEQUENCE_NODES 16
+#endif
+
+static_assert(SEQUENCE_NODES <= 16, "SequenceWindow tracks at most 16 nodes");
+
+class SequenceWindow {
+public:
+  SequenceWindow(void);
+
+  /**
+   * Check a frame and remember it
+   *
+   * @param node Node id, nodes out of range are never filtered
+   * @param epoch Epoch of the frame
+   * @param sequence Sequence number of the frame
+   * @return False if the frame is a duplicate and should be dropped
+   */
+  bool accept(uint8_t node, uint8_t epoch, uint8_t sequence);
+
+private:
+  uint8_t highest[SEQUENCE_NODES];
+  uint8_t seen[SEQUENCE_NODES]; /**< Bit n: highest - 1 - n has been seen */
+  uint8_t epochs[SEQUENCE_NODES];
+  uint16_t known;               /**< Bit n: node n + 1 has sent anything */
+};
+
+#endif //SCOUT_RF_FRAME_H
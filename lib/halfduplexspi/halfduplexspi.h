@@ -11,7 +11,8 @@
  *            4.7K
  *
  * use spi_byte for tdd bi-directional spi transfer, or
- * spi_in and spi_out for faster uni-directional transfer.
+ * spi_in and spi_out for faster uni-directional transfer,
+ * or outBurst and inBurst for uni-directional buffers.
  *
  * define SPI_PORT and SPI_SCK before including this file
  */
@@ -20,20 +21,50 @@
 #define SPI_SCK 2
 #define SPI_MOMI 0
 
-#define cbi(x, y)    x &= ~(1 << y)
-#define sbi(x, y)    x |= (1 << y)
-
 #ifndef SPI_MOMI
 #define SPI_MOMI (SPI_SCK - 1)
 #endif
 
+#ifndef __ASSEMBLER__
+
+#define cbi(x, y)    x &= ~(1 << y)
+#define sbi(x, y)    x |= (1 << y)
+
 #define SPI_DDR (*((&SPI_PORT) -1))
 #define SPI_PIN (*((&SPI_PORT) -2))
 
+// Constant 9 cycles per bit burst loops with SCK high for at most 2 of them, see burst.S.
+extern "C" {
+void spi_out_burst(const uint8_t *, uint8_t);
+void spi_in_burst(uint8_t *, uint8_t);
+}
+
 class HalfDuplexSPI {
 public:
   static void setup(void);
   static uint8_t byte(uint8_t);
   static uint8_t in(void);
   static void out(uint8_t);
+
+  /**
+   * Clock a buffer out MSB first, MOMI stays in output mode for the whole burst
+   *
+   * @param buf Where to get the data
+   * @param len How many bytes to transfer, 0 is a no-op
+   */
+  static void outBurst(const uint8_t *buf, uint8_t len) {
+    spi_out_burst(buf, len);
+  }
+
+  /**
+   * Clock a buffer in MSB first, MOMI stays in input mode for the whole burst
+   *
+   * @param buf Where to put the data
+   * @param len How many bytes to transfer, 0 is a no-op
+   */
+  static void inBurst(uint8_t *buf, uint8_t len) {
+    spi_in_burst(buf, len);
+  }
 };
+
+#endif
@@ -0,0 +1,104 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+#include "lightsensor.h"
+
+// 8MHz / 64 = 125kHz, within the 50-200kHz the ADC needs for full accuracy.
+static const uint8_t ADC_PRESCALER = _BV(ADPS2) | _BV(ADPS1);
+
+uint16_t LightSensor::filtered = 0;
+bool LightSensor::on = false;
+
+static volatile bool converted = false;
+
+ISR(ADC_vect) {
+  converted = true;
+}
+
+void LightSensor::setup(void) {
+  // Vcc as reference, the photocell divider is ratiometric. Left adjusted, ADCH is the 8-bit reading.
+  ADMUX = _BV(ADLAR) | _BV(MUX1) | _BV(MUX0);
+  DIDR0 |= _BV(ADC3D);
+
+  filtered = (uint16_t) sample() << LIGHT_FILTER;
+  on = level() < LIGHT_THRESHOLD;
+}
+
+bool LightSensor::update(void) {
+  filtered = filtered - (filtered >> LIGHT_FILTER) + sample();
+
+  uint8_t value = level();
+  bool was = on;
+
+  if (on && value >= LIGHT_THRESHOLD + LIGHT_HYSTERESIS / 2) {
+    on = false;
+  } else if (!on && value < LIGHT_THRESHOLD - LIGHT_HYSTERESIS / 2) {
+    on = true;
+  }
+
+  return on != was;
+}
+
+bool LightSensor::isOn(void) {
+  return on;
+}
+
+uint8_t LightSensor::level(void) {
+  return filtered >> LIGHT_FILTER;
+}
+
+uint16_t LightSensor::noise(void) {
+  uint8_t admux = ADMUX;
+  uint16_t value = 0;
+
+  PRR &= ~_BV(PRADC);
+
+  // Right adjusted, the bottom bit of ADCL is the one that flickers.
+  ADMUX = _BV(MUX1) | _BV(MUX0);
+
+  for (uint8_t i = 0; i < 16; i++) {
+    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADIF) | ADC_PRESCALER;
+    while (ADCSRA & _BV(ADSC));
+
+    uint8_t low = ADCL;
+    value = (value << 1 | (value >> 15)) ^ low ^ (ADCH << 4);
+  }
+
+  ADCSRA = 0;
+  ADMUX = admux;
+  PRR |= _BV(PRADC);
+
+  return value;
+}
+
+uint8_t LightSensor::sample(void) {
+  PRR &= ~_BV(PRADC);
+  ADCSRA = _BV(ADEN) | _BV(ADIE) | ADC_PRESCALER;
+
+  // Entering ADC noise reduction sleep starts the conversion, sleeping again while it runs doesn't restart it. Other
+  // interrupts wake us up too, keep sleeping until the conversion is done.
+  converted = false;
+  set_sleep_mode(SLEEP_MODE_ADC);
+
+  while (true) {
+    cli();
+    if (converted) {
+      sei();
+      break;
+    }
+
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+
+  uint8_t value = ADCH;
+
+  // ADC draws ~300uA while enabled.
+  ADCSRA = 0;
+  PRR |= _BV(PRADC);
+
+  return value;
+}
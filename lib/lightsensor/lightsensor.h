@@ -0,0 +1,100 @@
+#ifndef SCOUT_RF_LIGHTSENSOR_H
+#define SCOUT_RF_LIGHTSENSOR_H
+
+#include <avr/io.h>
+
+/* Photocell on PB3 read through ADC3
+ *
+ * An alternative to the pin change interrupt, which wakes the MCU up on every flicker around the logic threshold and
+ * on the slow ramp at dusk. Samples are taken in ADC noise reduction sleep, averaged and compared against a threshold
+ * with hysteresis, so only a real change of state counts. The application times update() with a Scheduler timer,
+ * i.e. by the WDT.
+ *
+ * Readings are 8-bit, light pulls the pin low like before, so the light is on below the threshold.
+ *
+ * @code
+ * LightSensor::setup();
+ * Scheduler::setTimer(TIMER_SAMPLE, LIGHT_SAMPLE_MS, EVENT_SAMPLE);
+ *
+ * case EVENT_SAMPLE:
+ *   Scheduler::setTimer(TIMER_SAMPLE, LIGHT_SAMPLE_MS, EVENT_SAMPLE);
+ *   if (LightSensor::update()) {
+ *     // LightSensor::isOn() has changed.
+ *   }
+ * @endcode
+ *
+ * define LIGHT_SAMPLE_MS, LIGHT_THRESHOLD, LIGHT_HYSTERESIS and LIGHT_FILTER before including this file to tune it.
+ */
+
+// Time between samples, rounded to WDT periods by the Scheduler.
+#ifndef LIGHT_SAMPLE_MS
+#define LIGHT_SAMPLE_MS 256
+#endif
+
+// Averaged reading the light switches at, 0-255.
+#ifndef LIGHT_THRESHOLD
+#define LIGHT_THRESHOLD 128
+#endif
+
+// Width of the band around the threshold where the state is kept.
+#ifndef LIGHT_HYSTERESIS
+#define LIGHT_HYSTERESIS 32
+#endif
+
+// Exponential average over 2^LIGHT_FILTER samples, 0 turns it off.
+#ifndef LIGHT_FILTER
+#define LIGHT_FILTER 2
+#endif
+
+static_assert(LIGHT_THRESHOLD >= LIGHT_HYSTERESIS / 2 && LIGHT_THRESHOLD + LIGHT_HYSTERESIS / 2 <= 255,
+              "Hysteresis band must fit into 0-255");
+static_assert(LIGHT_FILTER <= 8, "LIGHT_FILTER must be 0-8");
+
+class LightSensor {
+public:
+  /**
+   * Configure ADC3 and take the initial state from a single sample
+   *
+   * Disables the digital input of PB3, so PINB3 no longer follows the sensor.
+   */
+  static void setup(void);
+
+  /**
+   * Take a sample and update the state
+   *
+   * @return True if the state has changed
+   */
+  static bool update(void);
+
+  /**
+   * @return True if the light is on, as of the last update()
+   */
+  static bool isOn(void);
+
+  /**
+   * @return Averaged reading, 0-255
+   */
+  static uint8_t level(void);
+
+  /**
+   * Least significant bits of a few full resolution conversions, for seeding random numbers
+   *
+   * Busy-waits about 2ms, meant for startup. Works without setup() and leaves its configuration as it was.
+   *
+   * @return Noise, differs from run to run and from board to board
+   */
+  static uint16_t noise(void);
+
+private:
+  static uint16_t filtered; /**< Average scaled by 2^LIGHT_FILTER */
+  static bool on;
+
+  /**
+   * Single conversion in ADC noise reduction sleep, the ADC is powered only meanwhile
+   *
+   * @return 8-bit reading
+   */
+  static uint8_t sample(void);
+};
+
+#endif //SCOUT_RF_LIGHTSENSOR_H
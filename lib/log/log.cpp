@@ -0,0 +1,15 @@
+#include <util/atomic.h>
+
+#include "log.h"
+
+void (*Log::out)(uint8_t) = 0;
+
+void Log::setup(void (*out)(uint8_t)) {
+  Log::out = out;
+}
+
+void Log::send(uint8_t value) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    out(value);
+  }
+}
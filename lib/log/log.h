@@ -0,0 +1,107 @@
+#ifndef SCOUT_RF_LOG_H
+#define SCOUT_RF_LOG_H
+
+#include <avr/io.h>
+
+/* Tokenized logging
+ *
+ * Messages are defined by the application in a single X-macro table and their text never makes it into the firmware:
+ * only the position of a message in the table and its arguments in binary are sent. host/logdecode.py reads the same
+ * table and turns the records back into text. Placeholders {u8}, {u16} and {u32} in the text take the arguments in
+ * order, the arguments passed have to be of the same size.
+ *
+ * Record sent by LOG(), little endian:
+ *   'L', token, arguments
+ *
+ * Messages above LOG_LEVEL compile out together with their arguments, LOG_OFF compiles out everything.
+ *
+ * @code
+ * #define APP_MESSAGES(X) \
+ *   X(LOG_READY, LOG_INFO, "Ready") \
+ *   X(LOG_SENT, LOG_DEBUG, "Sent after {u8} retransmits")
+ *
+ * LOG_DEFINE(APP_MESSAGES)
+ *
+ * LOG_SETUP(TxByte);
+ * LOG(LOG_SENT, radio.getRetransmits());
+ * @endcode
+ */
+
+#define LOG_OFF 0
+#define LOG_ERROR 1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+#define LOG_TOKEN(token, level, text) token,
+#define LOG_LEVEL_OF(token, level, text) t == token ? level :
+
+/**
+ * Define enum LogToken and the constexpr logLevel(LogToken) lookup from a message table
+ *
+ * @param MESSAGES X-macro table, X(token, level, text) per message
+ */
+#define LOG_DEFINE(MESSAGES) \
+  enum LogToken { MESSAGES(LOG_TOKEN) LOG_TOKENS }; \
+  constexpr uint8_t logLevel(LogToken t) { return MESSAGES(LOG_LEVEL_OF) LOG_OFF; }
+
+#if LOG_LEVEL > LOG_OFF
+#define LOG_SETUP(out) Log::setup(out)
+#define LOG(token, ...) do { if (logLevel(token) <= LOG_LEVEL) { Log::write(token, ##__VA_ARGS__); } } while (0)
+#else
+#define LOG_SETUP(out)
+#define LOG(token, ...) do {} while (0)
+#endif
+
+class Log {
+public:
+  /**
+   * @param out Where records go, e.g. TxByte
+   */
+  static void setup(void (*out)(uint8_t));
+
+  /**
+   * Send a record, use LOG() instead so messages above LOG_LEVEL compile out
+   *
+   * @param token Message token
+   * @param args Arguments of the placeholders, u8, u16 or u32 each
+   */
+  template<typename... Args>
+  static void write(uint8_t token, Args... args) {
+    if (!out) {
+      return;
+    }
+
+    send('L');
+    send(token);
+    put(args...);
+  }
+
+private:
+  static void (*out)(uint8_t);
+
+  /**
+   * Send a byte with interrupts off, an interrupt within a soft UART byte would stretch a bit
+   */
+  static void send(uint8_t value);
+
+  static void put(void) {
+  }
+
+  template<typename T, typename... Args>
+  static void put(T value, Args... args) {
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "Log arguments are u8, u16 or u32");
+
+    for (uint8_t i = 0; i < sizeof(T); i++) {
+      send(value >> (i << 3));
+    }
+
+    put(args...);
+  }
+};
+
+#endif //SCOUT_RF_LOG_H
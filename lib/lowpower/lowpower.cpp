@@ -0,0 +1,181 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+
+#include "lowpower.h"
+#include "metrics.h"
+
+// Largest WDT prescaler, 8s.
+static const uint8_t MAX_PRESCALER = 9;
+
+// Timer0 ticks at F_CPU/1024 during one nominal 16ms WDT period.
+static const uint16_t CALIBRATION_TICKS = F_CPU / 1024 * 16 / 1000;
+
+uint16_t LowPower::scale = WDT_SCALE;
+uint8_t LowPower::tickPrescaler = 0;
+
+static volatile bool fired = false;
+static volatile bool woken = false;
+static volatile uint8_t ticks = 0;
+
+ISR(WDT_vect) {
+  fired = true;
+
+  if (ticks != 0xff) {
+    ticks++;
+  }
+}
+
+bool LowPower::sleepFor(uint32_t ms) {
+  while (ms >= period(0)) {
+    uint8_t prescaler = MAX_PRESCALER;
+    while (prescaler && period(prescaler) > ms) {
+      prescaler--;
+    }
+
+    if (!sleepPeriod(prescaler)) {
+      return false;
+    }
+
+    ms -= period(prescaler);
+  }
+
+  METRICS_START(PHASE_BUSY_DELAY);
+  while (ms--) {
+    _delay_ms(1);
+  }
+  METRICS_STOP(PHASE_BUSY_DELAY);
+
+  return true;
+}
+
+bool LowPower::sleepPeriod(uint8_t prescaler) {
+  fired = false;
+  start(prescaler);
+
+  bool elapsed = sleepUntilWake();
+
+  stop();
+
+  // Partial period of an early wake up is unknown, and it's not counted anywhere else either.
+  if (elapsed) {
+    METRICS_SLEPT(period(prescaler));
+  }
+
+  return elapsed;
+}
+
+void LowPower::startTicks(uint8_t prescaler) {
+  tickPrescaler = prescaler;
+  fired = false;
+  ticks = 0;
+  start(prescaler);
+}
+
+void LowPower::stopTicks(void) {
+  stop();
+}
+
+uint8_t LowPower::sleepTick(void) {
+  if (!sleepUntilWake()) {
+    return 0;
+  }
+
+  // WDT stays in interrupt mode and the next period is already running.
+  cli();
+  uint8_t completed = ticks;
+  ticks = 0;
+  fired = false;
+  sei();
+
+  // Includes whatever part of the periods has been spent awake, Timer1 doesn't count those as sleep either way.
+  METRICS_SLEPT(period(tickPrescaler) * completed);
+
+  return completed;
+}
+
+void LowPower::sleep(void) {
+  fired = false;
+  sleepUntilWake();
+}
+
+bool LowPower::sleepUntilWake(void) {
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+
+  // Other pin changes wake us up too, keep sleeping until either WDT fires or wake() is called from elsewhere.
+  // Flags are checked with interrupts off, sei right before sleep_cpu takes effect only after it.
+  while (true) {
+    cli();
+    if (woken) {
+      woken = false;
+      sei();
+      return false;
+    }
+
+    if (fired) {
+      sei();
+      return true;
+    }
+
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+}
+
+void LowPower::wake(void) {
+  woken = true;
+}
+
+uint16_t LowPower::calibrate(void) {
+  uint8_t tccr0a = TCCR0A, tccr0b = TCCR0B;
+
+  // First WDT period after start can be partial, sync to its first interrupt.
+  fired = false;
+  start(0);
+  while (!fired);
+
+  TCCR0A = 0;
+  TCNT0 = 0;
+  TCCR0B = _BV(CS02) | _BV(CS00);
+
+  fired = false;
+  while (!fired);
+
+  uint8_t ticks = TCNT0;
+
+  TCCR0B = tccr0b;
+  TCCR0A = tccr0a;
+  stop();
+
+  scale = (uint32_t) ticks * 256 / CALIBRATION_TICKS;
+
+  return scale;
+}
+
+void LowPower::start(uint8_t prescaler) {
+  uint8_t wdtcr = _BV(WDIE) | (prescaler & 0b111) | (prescaler & 0b1000 ? _BV(WDP3) : 0);
+
+  // Timed sequence, WDCE opens a 4 cycle window for the new configuration.
+  cli();
+  // Restarted periods start from 0.
+  wdt_reset();
+  MCUSR &= ~_BV(WDRF);
+  WDTCR = _BV(WDCE) | _BV(WDE);
+  WDTCR = wdtcr;
+  sei();
+}
+
+void LowPower::stop(void) {
+  cli();
+  WDTCR = _BV(WDCE) | _BV(WDE);
+  WDTCR = 0;
+  sei();
+}
+
+uint32_t LowPower::period(uint8_t prescaler) {
+  return ((uint32_t) 16 << prescaler) * scale >> 8;
+}
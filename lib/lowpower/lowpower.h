@@ -0,0 +1,120 @@
+#ifndef SCOUT_RF_LOWPOWER_H
+#define SCOUT_RF_LOWPOWER_H
+
+#include <avr/io.h>
+
+/* Watchdog timer based low-power delays
+ *
+ * The MCU sleeps in power down and is woken up by the WDT interrupt, long delays are chained from the largest WDT
+ * periods that fit (16ms * 2^n, up to 8s).
+ *
+ * define WDT_SCALE before including this file to compensate a known WDT oscillator drift, actual WDT period is
+ * nominal * WDT_SCALE / 256. LowPower::calibrate() measures it against the system clock at runtime instead.
+ */
+
+#ifndef WDT_SCALE
+#define WDT_SCALE 256
+#endif
+
+class LowPower {
+public:
+  /**
+   * Sleep in power down for the given time
+   *
+   * Any pin change still wakes the MCU up, but only wake() ends the sleep early. The remainder below the shortest
+   * WDT period is busy-waited.
+   *
+   * @code
+   * ISR(PCINT0_vect) {
+   *   LowPower::wake();
+   * }
+   *
+   * if (!LowPower::sleepFor(60000)) {
+   *   // Woken up early by a pin change.
+   * }
+   * @endcode
+   *
+   * @param ms How long to sleep, in milliseconds
+   * @return True if the whole period elapsed, false if it was cut short by wake()
+   */
+  static bool sleepFor(uint32_t ms);
+
+  /**
+   * Sleep in power down for a single WDT period
+   *
+   * @param prescaler WDT prescaler, period is 16ms * 2^prescaler, 0-9
+   * @return True if the whole period elapsed, false if it was cut short by wake()
+   */
+  static bool sleepPeriod(uint8_t prescaler);
+
+  /**
+   * Start WDT periods that repeat until stopTicks(), see sleepTick()
+   *
+   * @param prescaler WDT prescaler, period is 16ms * 2^prescaler, 0-9
+   */
+  static void startTicks(uint8_t prescaler);
+
+  /**
+   * Stop the periods started by startTicks()
+   */
+  static void stopTicks(void);
+
+  /**
+   * Sleep in power down until the current WDT period completes or wake() is called
+   *
+   * Unlike sleepPeriod(), a wake up leaves the period running and the next call waits for the rest of it, so time
+   * spent awake in between is part of the period. Returns right away if periods have completed meanwhile.
+   *
+   * @return Number of periods completed since the previous call, 0 if cut short by wake()
+   */
+  static uint8_t sleepTick(void);
+
+  /**
+   * Sleep in power down with WDT off until wake() is called
+   */
+  static void sleep(void);
+
+  /**
+   * Cut the current or the next sleep short, meant to be called from interrupt handlers
+   *
+   * A wake() that comes in just before a sleep call makes that sleep return right away, so it can't get lost.
+   */
+  static void wake(void);
+
+  /**
+   * Actual length of a WDT period, in milliseconds
+   *
+   * @param prescaler WDT prescaler, 0-9
+   */
+  static uint32_t period(uint8_t prescaler);
+
+  /**
+   * Measure the WDT oscillator against the system clock and use the result to compensate further sleeps
+   *
+   * Uses Timer0 for about 32ms, its configuration is restored afterwards. Interrupts must be enabled.
+   *
+   * @return New WDT scale, 256 means the WDT runs at its nominal 128kHz
+   */
+  static uint16_t calibrate(void);
+
+private:
+  static uint16_t scale; /**< Actual WDT period is nominal * scale / 256 */
+  static uint8_t tickPrescaler;
+
+  /**
+   * Start WDT in interrupt mode
+   *
+   * @param prescaler WDT prescaler, period is 16ms * 2^prescaler, 0-9
+   */
+  static void start(uint8_t prescaler);
+  static void stop(void);
+
+  /**
+   * Sleep in power down until WDT fires, if it's running, or wake() is called
+   *
+   * @return True if WDT fired, false if woken up, the wake up is consumed
+   */
+  static bool sleepUntilWake(void);
+};
+
+#endif //SCOUT_RF_LOWPOWER_H
@@ -0,0 +1,158 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include "metrics.h"
+
+#ifdef METRICS
+
+// Timer1 clock select for 1us ticks.
+#if F_CPU == 16000000L
+#define METRICS_TIMER_CS (_BV(CS12) | _BV(CS10))
+#elif F_CPU == 8000000L
+#define METRICS_TIMER_CS _BV(CS12)
+#elif F_CPU == 1000000L
+#define METRICS_TIMER_CS _BV(CS10)
+#else
+#error Metrics need F_CPU of 1, 8 or 16MHz
+#endif
+
+static volatile uint32_t overflows = 0;
+
+uint32_t Metrics::phases[METRICS_PHASES];
+uint32_t Metrics::started[METRICS_PHASES];
+uint8_t Metrics::running = 0;
+uint32_t Metrics::sleptMs = 0;
+uint32_t Metrics::origin = 0;
+uint16_t Metrics::counters[METRICS_CALLS][METRICS_COUNTERS];
+uint8_t Metrics::current = CALL_OTHER;
+
+ISR(TIMER1_OVF_vect) {
+  overflows++;
+}
+
+void Metrics::setup(void) {
+  TCCR1 = METRICS_TIMER_CS;
+  TIMSK |= _BV(TOIE1);
+
+  reset();
+}
+
+uint32_t Metrics::now(void) {
+  uint32_t high;
+  uint8_t low;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    low = TCNT1;
+    high = overflows;
+
+    // Overflow happened but hasn't been serviced yet.
+    if ((TIFR & _BV(TOV1)) && low < 128) {
+      high++;
+    }
+  }
+
+  return (high << 8 | low) - origin;
+}
+
+void Metrics::start(uint8_t phase) {
+  if (running & _BV(phase)) {
+    return;
+  }
+
+  running |= _BV(phase);
+  started[phase] = now();
+}
+
+void Metrics::stop(uint8_t phase) {
+  if (!(running & _BV(phase))) {
+    return;
+  }
+
+  running &= ~_BV(phase);
+  phases[phase] += now() - started[phase];
+}
+
+void Metrics::slept(uint32_t ms) {
+  sleptMs += ms;
+
+  for (uint8_t phase = 0; phase < METRICS_PHASES; phase++) {
+    if (running & _BV(phase)) {
+      phases[phase] += ms * 1000;
+    }
+  }
+}
+
+void Metrics::count(uint8_t counter) {
+  counters[current][counter]++;
+}
+
+uint8_t Metrics::enter(uint8_t call) {
+  uint8_t previous = current;
+
+  current = call;
+  counters[call][COUNT_CALLS]++;
+
+  return previous;
+}
+
+void Metrics::leave(uint8_t call) {
+  current = call;
+}
+
+static void dump_u8(void (*out)(uint8_t), uint8_t value) {
+  // Soft UART bits are timed by the CPU, an interrupt within a byte would stretch a bit. A byte takes less than the
+  // 256us between Timer1 overflows, so TOV1 stays pending and no overflow is lost.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    out(value);
+  }
+}
+
+static void dump_u32(void (*out)(uint8_t), uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    dump_u8(out, value);
+    value >>= 8;
+  }
+}
+
+void Metrics::dump(void (*out)(uint8_t)) {
+  dump_u8(out, 'M');
+  dump_u32(out, now());
+  dump_u32(out, sleptMs);
+
+  for (uint8_t phase = 0; phase < METRICS_PHASES; phase++) {
+    uint32_t time = phases[phase];
+
+    // Running phases are reported up to now.
+    if (running & _BV(phase)) {
+      time += now() - started[phase];
+    }
+
+    dump_u32(out, time);
+  }
+
+  for (uint8_t call = 0; call < METRICS_CALLS; call++) {
+    for (uint8_t counter = 0; counter < METRICS_COUNTERS; counter++) {
+      dump_u8(out, counters[call][counter]);
+      dump_u8(out, counters[call][counter] >> 8);
+    }
+  }
+}
+
+void Metrics::reset(void) {
+  uint32_t elapsed = now();
+
+  // Restart running phases from the new origin.
+  for (uint8_t phase = 0; phase < METRICS_PHASES; phase++) {
+    started[phase] -= elapsed;
+  }
+
+  origin += elapsed;
+
+  memset(phases, 0, sizeof(phases));
+  memset(counters, 0, sizeof(counters));
+  sleptMs = 0;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef SCOUT_RF_METRICS_H
+#define SCOUT_RF_METRICS_H
+
+#include <avr/io.h>
+
+/* On-device time and energy accounting
+ *
+ * Timer1 runs at 1MHz and only while the MCU is awake, so its total is the awake time. On top of it the time spent
+ * in each phase is accumulated in microseconds, and SPI transactions, register reads and writes are counted per
+ * Radio API call. Sleep periods are added to the phases that keep running while the MCU sleeps, e.g. radio powered.
+ *
+ * Everything compiles out unless METRICS is defined, e.g. -DMETRICS in platformio.ini build_flags. The METRICS_*
+ * macros are meant to be used instead of calling Metrics directly.
+ *
+ * Record sent by Metrics::dump(), little endian:
+ *   'M', awake us (u32), slept ms (u32), METRICS_PHASES x us (u32),
+ *   METRICS_CALLS x METRICS_COUNTERS x count (u16)
+ */
+
+enum MetricsPhase {
+  PHASE_RADIO_POWERED = 0,
+  PHASE_RADIO_RX,
+  PHASE_RADIO_TX,
+  PHASE_SPI,
+  PHASE_CSN_DELAY,
+  PHASE_BUSY_DELAY,
+  METRICS_PHASES
+};
+
+enum MetricsCall {
+  CALL_OTHER = 0,
+  CALL_SETUP,
+  CALL_CONFIGURE,
+  CALL_POWER_UP,
+  CALL_POWER_DOWN,
+  CALL_OPEN_PIPE,
+  CALL_START_LISTENING,
+  CALL_STOP_LISTENING,
+  CALL_WRITE,
+  CALL_TX_STANDBY,
+  CALL_AVAILABLE,
+  CALL_READ,
+  METRICS_CALLS
+};
+
+enum MetricsCounter {
+  COUNT_CALLS = 0,
+  COUNT_TRANSACTIONS,
+  COUNT_REGISTER_READS,
+  COUNT_REGISTER_WRITES,
+  METRICS_COUNTERS
+};
+
+#ifdef METRICS
+
+#define METRICS_SETUP() Metrics::setup()
+#define METRICS_START(phase) Metrics::start(phase)
+#define METRICS_STOP(phase) Metrics::stop(phase)
+#define METRICS_SLEPT(ms) Metrics::slept(ms)
+#define METRICS_COUNT(counter) Metrics::count(counter)
+#define METRICS_CALL(call) MetricsScope metricsScope(call)
+
+class Metrics {
+public:
+  /**
+   * Start Timer1 and reset all counters
+   */
+  static void setup(void);
+
+  /**
+   * Awake time since setup() or reset(), in microseconds
+   */
+  static uint32_t now(void);
+
+  /**
+   * Start accumulating time for a phase, no-op if it's already running
+   */
+  static void start(uint8_t phase);
+
+  /**
+   * Stop accumulating time for a phase, no-op if it's not running
+   */
+  static void stop(uint8_t phase);
+
+  /**
+   * Account a sleep period to the phases that are still running
+   *
+   * @param ms How long the MCU slept, in milliseconds
+   */
+  static void slept(uint32_t ms);
+
+  /**
+   * Increment a counter of the Radio API call in progress
+   */
+  static void count(uint8_t counter);
+
+  /**
+   * Make a Radio API call the current one, see MetricsScope
+   *
+   * @return Previous current call
+   */
+  static uint8_t enter(uint8_t call);
+
+  /**
+   * Restore the previous current call
+   */
+  static void leave(uint8_t call);
+
+  /**
+   * Send the binary record, see the format above
+   *
+   * @code
+   * Metrics::dump(TxByte);
+   * @endcode
+   *
+   * @param out Byte sink
+   */
+  static void dump(void (*out)(uint8_t));
+
+  /**
+   * Zero all counters and accumulated times, running phases keep running
+   */
+  static void reset(void);
+
+private:
+  static uint32_t phases[METRICS_PHASES];
+  static uint32_t started[METRICS_PHASES];
+  static uint8_t running; /**< Bit mask of running phases */
+  static uint32_t sleptMs;
+  static uint32_t origin; /**< now() at the last reset() */
+  static uint16_t counters[METRICS_CALLS][METRICS_COUNTERS];
+  static uint8_t current;
+};
+
+/**
+ * Attributes SPI traffic to a Radio API call for the lifetime of the scope, nested calls restore the outer one.
+ */
+class MetricsScope {
+public:
+  MetricsScope(uint8_t call) : previous(Metrics::enter(call)) {}
+  ~MetricsScope() { Metrics::leave(previous); }
+
+private:
+  uint8_t previous;
+};
+
+#else
+
+#define METRICS_SETUP()
+#define METRICS_START(phase)
+#define METRICS_STOP(phase)
+#define METRICS_SLEPT(ms)
+#define METRICS_COUNT(counter)
+#define METRICS_CALL(call)
+
+#endif
+
+#endif //SCOUT_RF_METRICS_H
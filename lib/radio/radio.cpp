@@ -1,16 +1,46 @@
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <string.h>
 #include <util/delay.h>
+#include <util/delay_basic.h>
 
 #include "nRF24L01.h"
 #include "radio.h"
 #include "halfduplexspi.h"
+#include "metrics.h"
 
 static const uint8_t PAYLOAD_SIZE = 32;
-static const uint8_t ADDRESS_WIDTH = 5;
+
+// Output power learned by power control, erased EEPROM reads 0xff until the first change.
+static uint8_t EEMEM storedPower = 0xff;
 
 bool Radio::setup(void) {
+  // Set 1500uS (minimum for 32B payload in ESB@250KBPS) timeouts, to make testing a little easier
+  // WARNING: If this is ever lowered, either 250KBS mode with AA is broken or maximum packet
+  // sizes must never be used. See documentation for a more complete explanation.
+  // Data rate is the slowest (and most reliable) speed supported by all hardware.
+  return setup<RadioProfile<76, RATE_1MBPS, MAX, 5, 15> >();
+}
+
+bool Radio::setup_shadow(void) {
+  METRICS_CALL(CALL_SETUP);
+
   HalfDuplexSPI::setup();
 
+#ifdef RADIO_IRQ
+  // IRQ is a push-pull active low output, no pull-up is needed.
+  DDRB &= ~_BV(RADIO_IRQ);
+  PCMSK |= _BV(RADIO_IRQ);
+  GIMSK |= _BV(PCIE);
+#endif
+
+  csnDelay = CSN_DELAY_LOOPS;
+  powerControl = false;
+  linked = false;
+
   csnHigh();
 
   // Must allow the radio time to settle else configuration bits will not necessarily stick.
@@ -21,42 +51,106 @@ bool Radio::setup(void) {
   // WARNING: Delay is based on P-variant whereby non-P *may* require different timing.
   _delay_ms(5);
 
-  // Reset CONFIG and enable 16-bit CRC.
-  write_register(CONFIG, 0 | _BV(EN_CRC) | _BV(CRCO));
+  // Power down first, so that after a warm reset none of the intermediate states reach the air. resync() writes
+  // CONFIG last and powers the chip up once everything else is in place.
+  write_register(CONFIG, 0);
 
-  // Set 1500uS (minimum for 32B payload in ESB@250KBPS) timeouts, to make testing a little easier
-  // WARNING: If this is ever lowered, either 250KBS mode with AA is broken or maximum packet
-  // sizes must never be used. See documentation for a more complete explanation.
-  setRetries(5, 15);
+  // Payload widths and addresses as after power-on reset, until pipes are opened.
+  memset(rxPayloadWidth, 0, sizeof(rxPayloadWidth));
+  memset(rxAddress[0], 0xE7, ADDRESS_WIDTH);
+  memset(rxAddress[1], 0xC2, ADDRESS_WIDTH);
+  for (uint8_t pipe = 2; pipe < 6; pipe++) {
+    rxAddressByte[pipe - 2] = 0xC1 + pipe;
+  }
+  memset(txAddress, 0xE7, ADDRESS_WIDTH);
 
-  uint8_t setup = read_register(RF_SETUP);
+  // Reset current status and flush buffers.
+  write_register(STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
+  flush_rx();
+  flush_tx();
 
-  // Then set the data rate to the slowest (and most reliable) speed supported by all
-  // hardware.
-  setDataRate(DataRate::RATE_1MBPS);
+  // Enable PTX, do not write CE high so radio will remain in standby I mode ( 130us max to transition to RX or TX
+  // instead of 1500us from powerUp ) PTX should use only 22uA of power.
+  resync();
 
-  write_register(FEATURE, 0);
-  write_register(DYNPD, 0);
+  // If RF_SETUP reads back 0 or ff then there was no response from module, anything else but the requested value
+  // means it's not nRF24L01+.
+  if (read_register(RF_SETUP) != rfSetup) {
+    return false;
+  }
 
-  // Reset current status
-  // Notice reset and flush is the last thing we do
-  write_register(STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
+#ifdef CSN_RC_CALIBRATE
+  calibrateCsnDelay();
+#endif
 
-  setChannel(76);
+  return true;
+}
 
-  // Flush buffers
-  flush_rx();
-  flush_tx();
+bool Radio::verify(void) {
+  METRICS_CALL(CALL_SETUP);
 
-  //Power up by default when setup() is called.
-  powerUp();
+  if (read_register(CONFIG) != config || read_register(EN_AA) != enAA || read_register(EN_RXADDR) != enRxAddr ||
+      read_register(SETUP_AW) != setupAw || read_register(SETUP_RETR) != setupRetr || read_register(RF_CH) != rfCh ||
+      read_register(RF_SETUP) != rfSetup || read_register(FEATURE) != feature ||
+      read_register(DYNPD) != dynpd ||
+      read_register(RX_PW_P0) != rxPayloadWidth[0] || read_register(RX_PW_P1) != rxPayloadWidth[1]) {
+    return false;
+  }
 
-  // Enable PTX, do not write CE high so radio will remain in standby I mode ( 130us max to transition to RX or TX
-  // instead of 1500us from powerUp ) PTX should use only 22uA of power.
-  write_register(CONFIG, (read_register(CONFIG)) & ~_BV(PRIM_RX));
+  for (uint8_t pipe = 2; pipe < 6; pipe++) {
+    if (read_register(RX_PW_P0 + pipe) != rxPayloadWidth[pipe] ||
+        read_register(RX_ADDR_P0 + pipe) != rxAddressByte[pipe - 2]) {
+      return false;
+    }
+  }
+
+  uint8_t address[ADDRESS_WIDTH];
+  uint8_t width = address_width();
+
+  read_register(RX_ADDR_P0, address, width);
+  if (memcmp(address, rxAddress[0], width)) {
+    return false;
+  }
+
+  read_register(RX_ADDR_P1, address, width);
+  if (memcmp(address, rxAddress[1], width)) {
+    return false;
+  }
 
-  // If setup is 0 or ff then there was no response from module.
-  return setup != 0 && setup != 0xff;
+  read_register(TX_ADDR, address, width);
+  return !memcmp(address, txAddress, width);
+}
+
+void Radio::resync(void) {
+  METRICS_CALL(CALL_SETUP);
+
+  write_register(EN_AA, enAA);
+  write_register(EN_RXADDR, enRxAddr);
+  write_register(SETUP_AW, setupAw);
+  write_register(SETUP_RETR, setupRetr);
+  write_register(RF_CH, rfCh);
+  write_register(RF_SETUP, rfSetup);
+  // DYNPD has effect only with EN_DPL set, so FEATURE goes first.
+  write_register(FEATURE, feature);
+  write_register(DYNPD, dynpd);
+  for (uint8_t pipe = 0; pipe < 6; pipe++) {
+    write_register(RX_PW_P0 + pipe, rxPayloadWidth[pipe]);
+  }
+  write_register(RX_ADDR_P0, rxAddress[0], address_width());
+  write_register(RX_ADDR_P1, rxAddress[1], address_width());
+  for (uint8_t pipe = 2; pipe < 6; pipe++) {
+    write_register(RX_ADDR_P0 + pipe, rxAddressByte[pipe - 2]);
+  }
+  write_register(TX_ADDR, txAddress, address_width());
+
+  // CONFIG goes last, if it powers the chip up it has to pass through stand-by first, see powerUp().
+  write_register(CONFIG, config);
+  if (config & _BV(PWR_UP)) {
+    METRICS_START(PHASE_RADIO_POWERED);
+    METRICS_START(PHASE_BUSY_DELAY);
+    _delay_ms(5);
+    METRICS_STOP(PHASE_BUSY_DELAY);
+  }
 }
 
 uint8_t Radio::get_status(void) {
@@ -70,13 +164,12 @@ uint8_t Radio::get_status(void) {
 }
 
 uint8_t Radio::read_register(uint8_t reg, uint8_t *buf, uint8_t len) {
+  METRICS_COUNT(COUNT_REGISTER_READS);
+
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(R_REGISTER | (REGISTER_MASK & reg));
-
-  while (len--) {
-    *buf++ = HalfDuplexSPI::byte(0xff);
-  }
+  HalfDuplexSPI::inBurst(buf, len);
 
   csnHigh();
 
@@ -84,10 +177,12 @@ uint8_t Radio::read_register(uint8_t reg, uint8_t *buf, uint8_t len) {
 }
 
 uint8_t Radio::read_register(uint8_t reg) {
+  METRICS_COUNT(COUNT_REGISTER_READS);
+
   csnLow();
 
   HalfDuplexSPI::byte(R_REGISTER | (REGISTER_MASK & reg));
-  uint8_t result = HalfDuplexSPI::byte(0xff);
+  uint8_t result = HalfDuplexSPI::in();
 
   csnHigh();
 
@@ -95,11 +190,26 @@ uint8_t Radio::read_register(uint8_t reg) {
 }
 
 uint8_t Radio::write_register(uint8_t reg, const uint8_t *buf, uint8_t len) {
+  METRICS_COUNT(COUNT_REGISTER_WRITES);
+
+  csnLow();
+
+  uint8_t status = HalfDuplexSPI::byte(W_REGISTER | (REGISTER_MASK & reg));
+  HalfDuplexSPI::outBurst(buf, len);
+
+  csnHigh();
+
+  return status;
+}
+
+uint8_t Radio::write_register_P(uint8_t reg, const uint8_t *buf, uint8_t len) {
+  METRICS_COUNT(COUNT_REGISTER_WRITES);
+
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(W_REGISTER | (REGISTER_MASK & reg));
   while (len--) {
-    HalfDuplexSPI::byte(*buf++);
+    HalfDuplexSPI::out(pgm_read_byte(buf++));
   }
 
   csnHigh();
@@ -108,29 +218,208 @@ uint8_t Radio::write_register(uint8_t reg, const uint8_t *buf, uint8_t len) {
 }
 
 uint8_t Radio::write_register(uint8_t reg, uint8_t value) {
+  METRICS_COUNT(COUNT_REGISTER_WRITES);
+
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(W_REGISTER | (REGISTER_MASK & reg));
-  HalfDuplexSPI::byte(value);
+  HalfDuplexSPI::out(value);
 
   csnHigh();
 
   return status;
 }
 
+void Radio::update_register(uint8_t reg, uint8_t &shadow, uint8_t value) {
+  if (shadow == value) {
+    return;
+  }
+
+  write_register(reg, value);
+  shadow = value;
+}
+
+void Radio::update_address(uint8_t reg, uint8_t *shadow, const uint8_t *address, bool progmem) {
+  uint8_t width = address_width();
+
+  if (progmem) {
+    if (!memcmp_P(shadow, address, width)) {
+      return;
+    }
+
+    write_register_P(reg, address, width);
+    memcpy_P(shadow, address, width);
+    return;
+  }
+
+  if (!memcmp(shadow, address, width)) {
+    return;
+  }
+
+  write_register(reg, address, width);
+  memcpy(shadow, address, width);
+}
+
+uint8_t Radio::address_width(void) {
+  return setupAw + 2;
+}
+
 void Radio::setRetries(uint8_t delay, uint8_t count) {
-  write_register(SETUP_RETR, (delay & 0xf) << ARD | (count & 0xf) << ARC);
+  METRICS_CALL(CALL_CONFIGURE);
+
+  update_register(SETUP_RETR, setupRetr, (delay & 0xf) << ARD | (count & 0xf) << ARC);
+}
+
+uint8_t Radio::getRetransmits(void) {
+  return read_register(OBSERVE_TX) >> ARC_CNT & 0xf;
+}
+
+uint8_t Radio::getLostPackets(void) {
+  return read_register(OBSERVE_TX) >> PLOS_CNT;
+}
+
+uint16_t Radio::calibrateCsnDelay(void) {
+  METRICS_CALL(CALL_SETUP);
+
+  if (!csn_delay_works(CSN_DELAY_LOOPS)) {
+    csnDelay = CSN_DELAY_LOOPS;
+    resync();
+    return 0;
+  }
+
+  uint16_t low = 1, high = CSN_DELAY_LOOPS;
+
+  while (low < high) {
+    uint16_t middle = (low + high) / 2;
+
+    if (csn_delay_works(middle)) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  // Leave some margin for temperature and supply drift, but never go above the compile-time delay.
+  high += high / 4 + 1;
+  csnDelay = high < CSN_DELAY_LOOPS ? high : CSN_DELAY_LOOPS;
+
+  // A transaction with too short a delay loses its leading command bits, so a read can turn into a write to another
+  // register, e.g. R_REGISTER RF_CH into W_REGISTER RX_ADDR_Px. Put back whatever the search overwrote.
+  if (!verify()) {
+    resync();
+  }
+
+  return csnDelay;
+}
+
+bool Radio::csn_delay_works(uint16_t delay) {
+  // Previous attempt could have left CSN half way, settle it with the safe delay first.
+  csnDelay = CSN_DELAY_LOOPS;
+  csnHigh();
+
+  csnDelay = delay;
+
+  // Alternate registers so that two transactions merged by a CSN which didn't rise in time are caught too.
+  for (uint8_t i = 0; i < 8; i++) {
+    if (read_register(RF_SETUP) != rfSetup || read_register(RF_CH) != rfCh) {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 void Radio::setOutputPower(OutputPower power) {
-  uint8_t setup = read_register(RF_SETUP) & 0b11111000;
+  METRICS_CALL(CALL_CONFIGURE);
+
+  uint8_t setup = rfSetup & 0b11111000;
   uint8_t level = (power << 1) + 1;
 
-  write_register(RF_SETUP, setup |= level);
+  update_register(RF_SETUP, rfSetup, setup | level);
+}
+
+OutputPower Radio::getOutputPower(void) {
+  return (OutputPower) (rfSetup >> RF_PWR_LOW & 0b11);
+}
+
+void Radio::enablePowerControl(void) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  restore_power();
+  powerControl = true;
+}
+
+void Radio::restore_power(void) {
+  uint8_t power = eeprom_read_byte(&storedPower);
+  if (power <= MAX) {
+    setOutputPower((OutputPower) power);
+  }
+
+  firstTryAcks = 0;
+  linked = false;
+}
+
+uint16_t Radio::payload_airtime(uint8_t len) {
+  uint8_t crc = config & _BV(EN_CRC) ? (config & _BV(CRCO) ? 2 : 1) : 0;
+  // Preamble, address, payload and CRC bytes plus the 9-bit packet control field.
+  uint16_t bits = 8 * (1 + address_width() + len + crc) + 9;
+
+  if (rfSetup & _BV(RF_DR_LOW)) {
+    bits <<= 2;
+  } else if (rfSetup & _BV(RF_DR_HIGH)) {
+    bits >>= 1;
+  }
+
+  return 130 + bits;
+}
+
+void Radio::adapt_power(bool sent) {
+  if (!powerControl) {
+    return;
+  }
+
+  uint8_t current = getOutputPower();
+  uint8_t power = current;
+
+  if (!sent) {
+    firstTryAcks = 0;
+
+    if (power < MAX) {
+      power++;
+    }
+  } else if (!linked) {
+    // First ACK on this channel, keep the level that got through.
+    linked = true;
+    firstTryAcks = 0;
+    eeprom_update_byte(&storedPower, power);
+  } else if (getRetransmits()) {
+    firstTryAcks = 0;
+  } else if (++firstTryAcks >= POWER_CONTROL_RUN) {
+    firstTryAcks = 0;
+
+    if (power > MIN) {
+      power--;
+    }
+  }
+
+  // EEPROM only sees actual level changes.
+  if (power == current) {
+    return;
+  }
+
+  setOutputPower((OutputPower) power);
+
+  // Until an ACK comes in, failures may just as well mean there's no hub on the channel, so raised levels are kept
+  // out of EEPROM.
+  if (linked) {
+    eeprom_update_byte(&storedPower, power);
+  }
 }
 
 bool Radio::setDataRate(DataRate rate) {
-  uint8_t setup = read_register(RF_SETUP);
+  METRICS_CALL(CALL_CONFIGURE);
+
+  uint8_t setup = rfSetup;
 
   // HIGH and LOW '00' is 1Mbs - our default
   setup &= ~(_BV(RF_DR_LOW) | _BV(RF_DR_HIGH));
@@ -147,93 +436,381 @@ bool Radio::setDataRate(DataRate rate) {
     txRxDelay = 65;
   }
 
-  write_register(RF_SETUP, setup);
+  update_register(RF_SETUP, rfSetup, setup);
 
   // Verify our result.
   return read_register(RF_SETUP) == setup;
 }
 
 void Radio::setChannel(uint8_t channel) {
+  METRICS_CALL(CALL_CONFIGURE);
+
   const uint8_t max_channel = 125;
-  write_register(RF_CH, channel > max_channel ? max_channel : channel);
+  uint8_t previous = rfCh;
+
+  update_register(RF_CH, rfCh, channel > max_channel ? max_channel : channel);
+
+  // Levels raised while looking for the hub on the previous channel say nothing about this one.
+  if (powerControl && rfCh != previous) {
+    restore_power();
+  }
+}
+
+bool Radio::testRpd(void) {
+  return read_register(RPD) & 1;
+}
+
+void Radio::surveyChannels(uint8_t *map, uint8_t samples) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  uint8_t mode = config;
+  uint8_t channel = rfCh;
+
+  memset(map, 0, CHANNEL_MAP_SIZE);
+  samples = samples > 15 ? 15 : samples;
+
+  METRICS_START(PHASE_RADIO_RX);
+
+  for (uint8_t current = 0; current < CHANNELS; current++) {
+    // With CE tied high RX mode is only left through power down, the channel is switched meanwhile.
+    update_register(CONFIG, config, config & ~(_BV(PWR_UP) | _BV(PRIM_RX)));
+    update_register(RF_CH, rfCh, current);
+    update_register(CONFIG, config, config | _BV(PWR_UP) | _BV(PRIM_RX));
+
+    METRICS_START(PHASE_BUSY_DELAY);
+    _delay_us(RPD_SETTLE_US);
+    METRICS_STOP(PHASE_BUSY_DELAY);
+
+    // A register read takes longer than the 40us RPD filter, so every sample is a fresh one.
+    uint8_t busy = 0;
+    for (uint8_t sample = 0; sample < samples; sample++) {
+      busy += testRpd();
+    }
+
+    map[current >> 1] |= busy << ((current & 1) << 2);
+  }
+
+  METRICS_STOP(PHASE_RADIO_RX);
+
+  update_register(CONFIG, config, config & ~(_BV(PWR_UP) | _BV(PRIM_RX)));
+  update_register(RF_CH, rfCh, channel);
+
+  flush_rx();
+  write_register(STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
+
+  // Same as stopListening(), the radio settles on its own with CE high.
+  update_register(CONFIG, config, mode);
+  if (mode & _BV(PRIM_RX)) {
+    METRICS_START(PHASE_RADIO_RX);
+  }
+}
+
+uint8_t Radio::channelOccupancy(const uint8_t *map, uint8_t channel) {
+  return map[channel >> 1] >> ((channel & 1) << 2) & 0xf;
+}
+
+void Radio::rankChannels(const uint8_t *map, uint8_t *channels, uint8_t count) {
+  // Insertion sort, the list is a handful of channels.
+  for (uint8_t i = 1; i < count; i++) {
+    uint8_t channel = channels[i];
+    uint8_t occupancy = channelOccupancy(map, channel);
+    uint8_t j = i;
+
+    for (; j && channelOccupancy(map, channels[j - 1]) > occupancy; j--) {
+      channels[j] = channels[j - 1];
+    }
+
+    channels[j] = channel;
+  }
 }
 
 void Radio::powerDown(void) {
-  write_register(CONFIG, read_register(CONFIG) & ~_BV(PWR_UP));
+  METRICS_CALL(CALL_POWER_DOWN);
+
+  update_register(CONFIG, config, config & ~_BV(PWR_UP));
+
+  METRICS_STOP(PHASE_RADIO_POWERED);
+  METRICS_STOP(PHASE_RADIO_RX);
+  METRICS_STOP(PHASE_RADIO_TX);
 }
 
 void Radio::powerUp(void) {
-  uint8_t cfg = read_register(CONFIG);
+  METRICS_CALL(CALL_POWER_UP);
 
   // Return immediately if already powered up.
-  if (cfg & _BV(PWR_UP)) {
+  if (config & _BV(PWR_UP)) {
     return;
   }
 
-  write_register(CONFIG, cfg | _BV(PWR_UP));
+  update_register(CONFIG, config, config | _BV(PWR_UP));
+  METRICS_START(PHASE_RADIO_POWERED);
 
   // For nRF24L01+ to go from power down mode to TX or RX mode it must first pass through stand-by mode.
   // There must be a delay of Tpd2stby (see Table 16.) after the nRF24L01+ leaves power down mode before
   // the CEis set high. - Tpd2stby can be up to 5ms per the 1.0 datasheet.
+  METRICS_START(PHASE_BUSY_DELAY);
   _delay_ms(5);
+  METRICS_STOP(PHASE_BUSY_DELAY);
 }
 
 void Radio::setAutoAck(bool enable) {
-  write_register(EN_AA, enable ? 0b111111 : 0);
+  METRICS_CALL(CALL_CONFIGURE);
+
+  update_register(EN_AA, enAA, enable ? 0b111111 : 0);
 }
 
 void Radio::setAutoAck(uint8_t pipe, bool enable) {
-  if (pipe > 6) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  if (pipe > 5) {
     return;
   }
 
-  uint8_t en_aa = read_register(EN_AA);
+  uint8_t en_aa = enAA;
   if (enable) {
     en_aa |= _BV(pipe);
   } else {
     en_aa &= ~_BV(pipe);
   }
 
-  write_register(EN_AA, en_aa);
+  update_register(EN_AA, enAA, en_aa);
+}
+
+void Radio::setInterruptMask(bool txSent, bool txFailed, bool rxReady) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  uint8_t mask = (txSent ? 0 : _BV(MASK_TX_DS)) | (txFailed ? 0 : _BV(MASK_MAX_RT)) | (rxReady ? 0 : _BV(MASK_RX_DR));
+
+  update_register(CONFIG, config, (config & ~(_BV(MASK_TX_DS) | _BV(MASK_MAX_RT) | _BV(MASK_RX_DR))) | mask);
+}
+
+#ifdef RADIO_IRQ
+uint8_t Radio::waitForIrq(void) {
+  METRICS_CALL(CALL_TX_STANDBY);
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+
+  // IRQ stays low until the flags are cleared, so checking it with interrupts off can't miss the edge.
+  cli();
+  while (PINB & _BV(RADIO_IRQ)) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  sei();
+
+  uint8_t events = get_status() & (_BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
+
+  // With CE high clearing MAX_RT resumes the transmission, drop the payload first.
+  if (events & _BV(MAX_RT)) {
+    flush_tx();
+  }
+
+  write_register(STATUS, events);
+
+  if (events & (_BV(TX_DS) | _BV(MAX_RT))) {
+    METRICS_STOP(PHASE_RADIO_TX);
+  }
+
+  return events;
+}
+
+uint8_t Radio::write(const void *buf, uint8_t len) {
+  METRICS_CALL(CALL_WRITE);
+
+  write_payload(buf, len, W_TX_PAYLOAD);
+
+  uint8_t events = waitForIrq();
+
+  adapt_power(events & _BV(TX_DS));
+
+  return events;
+}
+#endif
+
+void Radio::enableDynamicPayloads(void) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  update_register(FEATURE, feature, feature | _BV(EN_DPL));
+  update_register(DYNPD, dynpd, _BV(DPL_P5) | _BV(DPL_P4) | _BV(DPL_P3) | _BV(DPL_P2) | _BV(DPL_P1) | _BV(DPL_P0));
+}
+
+void Radio::setDynamicPayload(uint8_t pipe, bool enable) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  if (pipe > 5) {
+    return;
+  }
+
+  uint8_t dynamic = enable ? dynpd | _BV(pipe) : dynpd & ~_BV(pipe);
+
+  // EN_DPL stays on as long as at least one pipe uses dynamic payload length.
+  if (dynamic) {
+    update_register(FEATURE, feature, feature | _BV(EN_DPL));
+    update_register(DYNPD, dynpd, dynamic);
+  } else {
+    update_register(DYNPD, dynpd, dynamic);
+    update_register(FEATURE, feature, feature & ~_BV(EN_DPL));
+  }
+}
+
+uint8_t Radio::getDynamicPayloadSize(void) {
+  METRICS_CALL(CALL_READ);
+
+  csnLow();
+
+  HalfDuplexSPI::byte(R_RX_PL_WID);
+  uint8_t result = HalfDuplexSPI::in();
+
+  csnHigh();
+
+  // Width above 32 means the payload is corrupted and must be flushed.
+  if (result > PAYLOAD_SIZE) {
+    flush_rx();
+    return 0;
+  }
+
+  return result;
+}
+
+void Radio::enableAckPayload(void) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  update_register(FEATURE, feature, feature | _BV(EN_ACK_PAY) | _BV(EN_DPL));
+  update_register(DYNPD, dynpd, dynpd | _BV(DPL_P1) | _BV(DPL_P0));
+}
+
+void Radio::writeAckPayload(uint8_t pipe, const void *buf, uint8_t len) {
+  METRICS_CALL(CALL_WRITE);
+
+  write_payload(buf, len, W_ACK_PAYLOAD | (pipe & 0b111));
+}
+
+void Radio::writeAckPayload_P(uint8_t pipe, const void *buf, uint8_t len) {
+  METRICS_CALL(CALL_WRITE);
+
+  write_payload_P(buf, len, W_ACK_PAYLOAD | (pipe & 0b111));
 }
 
 void Radio::openWritingPipe(const uint8_t *address) {
+  METRICS_CALL(CALL_OPEN_PIPE);
+
   // Note that AVR 8-bit uC's store this LSB first, and the NRF24L01(+) expects it LSB first too, so we're good.
-  write_register(RX_ADDR_P0, address, ADDRESS_WIDTH);
-  write_register(TX_ADDR, address, ADDRESS_WIDTH);
-  write_register(RX_PW_P0, PAYLOAD_SIZE);
-  write_register(EN_RXADDR, read_register(EN_RXADDR) | _BV(ERX_P0));
+  update_address(RX_ADDR_P0, rxAddress[0], address);
+  update_address(TX_ADDR, txAddress, address);
+  update_register(RX_PW_P0, rxPayloadWidth[0], PAYLOAD_SIZE);
+  update_register(EN_RXADDR, enRxAddr, enRxAddr | _BV(ERX_P0));
+}
+
+void Radio::openWritingPipe_P(const uint8_t *address) {
+  METRICS_CALL(CALL_OPEN_PIPE);
+
+  update_address(RX_ADDR_P0, rxAddress[0], address, true);
+  update_address(TX_ADDR, txAddress, address, true);
+  update_register(RX_PW_P0, rxPayloadWidth[0], PAYLOAD_SIZE);
+  update_register(EN_RXADDR, enRxAddr, enRxAddr | _BV(ERX_P0));
+}
+
+void Radio::openReadingPipe(uint8_t pipe, const uint8_t *address) {
+  METRICS_CALL(CALL_OPEN_PIPE);
+
+  open_reading_pipe(pipe, address, false);
+}
+
+void Radio::openReadingPipe_P(uint8_t pipe, const uint8_t *address) {
+  METRICS_CALL(CALL_OPEN_PIPE);
+
+  open_reading_pipe(pipe, address, true);
+}
+
+void Radio::open_reading_pipe(uint8_t pipe, const uint8_t *address, bool progmem) {
+  if (pipe > 5) {
+    return;
+  }
+
+  if (pipe < 2) {
+    update_address(RX_ADDR_P0 + pipe, rxAddress[pipe], address, progmem);
+  } else {
+    // Pipes 2-5 only have the first byte of their own.
+    update_register(RX_ADDR_P0 + pipe, rxAddressByte[pipe - 2], progmem ? pgm_read_byte(address) : address[0]);
+  }
+
+  update_register(RX_PW_P0 + pipe, rxPayloadWidth[pipe], PAYLOAD_SIZE);
+  update_register(EN_RXADDR, enRxAddr, enRxAddr | _BV(pipe));
 }
 
 void Radio::openReadingPipe(const uint8_t *address) {
-  write_register(RX_ADDR_P1, address, ADDRESS_WIDTH);
-  write_register(RX_PW_P1, PAYLOAD_SIZE);
-  write_register(EN_RXADDR, read_register(EN_RXADDR) | _BV(ERX_P1));
+  openReadingPipe(1, address);
+}
+
+void Radio::closeReadingPipe(uint8_t pipe) {
+  METRICS_CALL(CALL_OPEN_PIPE);
+
+  if (pipe > 5) {
+    return;
+  }
+
+  update_register(EN_RXADDR, enRxAddr, enRxAddr & ~_BV(pipe));
+}
+
+void Radio::setPayloadSize(uint8_t pipe, uint8_t size) {
+  METRICS_CALL(CALL_CONFIGURE);
+
+  if (pipe > 5) {
+    return;
+  }
+
+  size = size < 1 ? 1 : size > PAYLOAD_SIZE ? PAYLOAD_SIZE : size;
+  update_register(RX_PW_P0 + pipe, rxPayloadWidth[pipe], size);
 }
 
 void Radio::startListening(void) {
-  write_register(CONFIG, read_register(CONFIG) | _BV(PRIM_RX));
+  METRICS_CALL(CALL_START_LISTENING);
+
+  update_register(CONFIG, config, config | _BV(PRIM_RX));
+  METRICS_STOP(PHASE_RADIO_TX);
+  METRICS_START(PHASE_RADIO_RX);
   write_register(STATUS, _BV(RX_DR) | _BV(TX_DS) | _BV(MAX_RT));
 
-  if (read_register(FEATURE) & _BV(EN_ACK_PAY)) {
+  if (feature & _BV(EN_ACK_PAY)) {
     flush_tx();
   }
 }
 
 void Radio::stopListening(void) {
-  if (read_register(FEATURE) & _BV(EN_ACK_PAY)) {
+  METRICS_CALL(CALL_STOP_LISTENING);
+
+  // Already in PTX, nothing to leave.
+  if (!(config & _BV(PRIM_RX))) {
+    return;
+  }
+
+  if (feature & _BV(EN_ACK_PAY)) {
+    METRICS_START(PHASE_BUSY_DELAY);
     _delay_us(155);
+    METRICS_STOP(PHASE_BUSY_DELAY);
     flush_tx();
   }
 
-  write_register(CONFIG, (read_register(CONFIG)) & ~_BV(PRIM_RX));
+  METRICS_STOP(PHASE_RADIO_RX);
+
+  if (!(config & _BV(PWR_UP))) {
+    update_register(CONFIG, config, config & ~_BV(PRIM_RX));
+    return;
+  }
 
-  // for 3 pins solution TX mode is only left with additional powerDown/powerUp cycle.
-  powerDown();
-  powerUp();
+  // With CE tied high RX mode is only left through power down, so PRIM_RX and PWR_UP are cleared in one write. No
+  // need to wait afterwards: CE high is what Tpd2stby protects and it is already high, the radio passes stand-by on
+  // its own and starts the 130us TX settling as soon as a payload is in the TX FIFO.
+  update_register(CONFIG, config, config & ~(_BV(PRIM_RX) | _BV(PWR_UP)));
+  update_register(CONFIG, config, config | _BV(PWR_UP));
 }
 
 bool Radio::writeFast(const void *buf, uint8_t len, const bool multicast) {
+  METRICS_CALL(CALL_WRITE);
+
   // Let's block if FIFO is full or max number of retries is reached. Return 0 so the user can control the retries
   // manually. The radio will auto-clear everything in the FIFO as long as CE remains high.
   while (get_status() & _BV(TX_FULL)) {
@@ -254,6 +831,8 @@ bool Radio::writeFast(const void *buf, uint8_t len) {
 }
 
 bool Radio::writeBlocking(const void *buf, uint8_t len, uint32_t timeout) {
+  METRICS_CALL(CALL_WRITE);
+
   uint32_t elapsed = 0;
 
   while (get_status() & _BV(TX_FULL)) {
@@ -267,7 +846,9 @@ bool Radio::writeBlocking(const void *buf, uint8_t len, uint32_t timeout) {
       }
     }
 
+    METRICS_START(PHASE_BUSY_DELAY);
     _delay_ms(100);
+    METRICS_STOP(PHASE_BUSY_DELAY);
     elapsed += 100;
   }
 
@@ -276,44 +857,178 @@ bool Radio::writeBlocking(const void *buf, uint8_t len, uint32_t timeout) {
   return 1;
 }
 
+void Radio::startFastWrite(const void *buf, uint8_t len, const bool multicast, bool startTx) {
+  METRICS_CALL(CALL_WRITE);
+
+  (void) startTx;
+
+  write_payload(buf, len, multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD);
+}
+
+uint8_t Radio::writeMany(const void *const *payloads, const uint8_t *lengths, uint8_t count, bool multicast) {
+  METRICS_CALL(CALL_WRITE);
+
+  // Payloads up to done are settled, up to queued are written to the TX FIFO.
+  uint8_t delivered = 0;
+  bool lost = false;
+  uint8_t done = 0;
+  uint8_t queued = 0;
+  uint8_t depth = 3;
+
+  count = count > 8 ? 8 : count;
+
+  if (multicast) {
+    // Whole refill has to be out within 4ms, every payload has to fit at least.
+    const uint16_t tx_limit = 4000;
+    uint16_t longest = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+      uint16_t airtime = payload_airtime(lengths[i]);
+      longest = airtime > longest ? airtime : longest;
+    }
+
+    depth = tx_limit / longest;
+    depth = depth > 3 ? 3 : depth ? depth : 1;
+  }
+
+  while (done < count) {
+    uint8_t fifo;
+    uint8_t status = read_register(FIFO_STATUS, &fifo, 1);
+
+    // Read STATUS again and clear TX_DS in the same transaction, so a TX_DS coming in between can't be cleared
+    // uncounted. FIFO_STATUS goes first, a payload that completes after it is counted by its TX_DS.
+    if (status & _BV(TX_DS)) {
+      status = write_register(STATUS, _BV(TX_DS));
+    }
+
+    if (fifo & _BV(TX_EMPTY)) {
+      // Everything queued is out, even if TX_DS of some payloads merged before it was seen.
+      while (done < queued) {
+        delivered |= _BV(done++);
+      }
+    } else if (status & _BV(TX_DS)) {
+      delivered |= _BV(done++);
+    }
+
+    if (status & _BV(MAX_RT)) {
+      // Only a full FIFO tells exactly how many payloads are left in it.
+      while ((fifo & _BV(TX_FULL)) && done + 3 < queued) {
+        delivered |= _BV(done++);
+      }
+
+      // Head of the FIFO ran out of retries, drop it and queue the rest again. MAX_RT is cleared only once the FIFO
+      // is flushed, with CE high clearing it resumes the transmission.
+      flush_tx();
+      write_register(STATUS, _BV(MAX_RT));
+      lost = true;
+      queued = ++done;
+    }
+
+    // Without ACK the radio has to pass through STANDBY-II between refills.
+    if (multicast && !(fifo & _BV(TX_EMPTY)) && !(status & _BV(MAX_RT))) {
+      continue;
+    }
+
+    // queued - done can only overestimate what's in the FIFO, so it never overflows.
+    while (queued < count && queued - done < depth) {
+      write_payload(payloads[queued], lengths[queued], multicast ? W_TX_PAYLOAD_NO_ACK : W_TX_PAYLOAD);
+      queued++;
+    }
+  }
+
+  METRICS_STOP(PHASE_RADIO_TX);
+
+  // Power control steps once per call, however many payloads have been dropped.
+  if (lost) {
+    adapt_power(false);
+  } else if (count && (delivered & _BV(count - 1))) {
+    adapt_power(true);
+  }
+
+  return delivered;
+}
+
 bool Radio::txStandBy() {
+  METRICS_CALL(CALL_TX_STANDBY);
+
   while (!(read_register(FIFO_STATUS) & _BV(TX_EMPTY))) {
     if (get_status() & _BV(MAX_RT)) {
-      write_register(STATUS, _BV(MAX_RT));
-      // Non blocking, flush the data.
+      // Non blocking, flush the data. With CE high clearing MAX_RT first would resume the transmission.
       flush_tx();
+      write_register(STATUS, _BV(MAX_RT));
+      adapt_power(false);
       return 0;
     }
   }
 
+  METRICS_STOP(PHASE_RADIO_TX);
+  adapt_power(true);
+
   return 1;
 }
 
 bool Radio::txStandBy(uint32_t timeout) {
+  METRICS_CALL(CALL_TX_STANDBY);
+
   uint32_t elapsed = 0;
+  bool retried = false;
 
   while (!(read_register(FIFO_STATUS) & _BV(TX_EMPTY))) {
     if (get_status() & _BV(MAX_RT)) {
-      write_register(STATUS, _BV(MAX_RT));
-
+      // Clearing MAX_RT starts another round of retries, power control only sees the final outcome.
       if (elapsed >= timeout) {
         flush_tx();
+        write_register(STATUS, _BV(MAX_RT));
+        adapt_power(false);
         return 0;
       }
+
+      write_register(STATUS, _BV(MAX_RT));
+      retried = true;
     }
 
     elapsed += 200;
+    METRICS_START(PHASE_BUSY_DELAY);
     _delay_ms(200);
+    METRICS_STOP(PHASE_BUSY_DELAY);
+  }
+
+  METRICS_STOP(PHASE_RADIO_TX);
+
+  // Delivered only after extra rounds, that's no reason to step down.
+  if (retried) {
+    firstTryAcks = 0;
+  } else {
+    adapt_power(true);
   }
 
   return 1;
 }
 
 bool Radio::available() {
-  return !(read_register(FIFO_STATUS) & _BV(RX_EMPTY));
+  return available(0);
+}
+
+bool Radio::available(uint8_t *pipe) {
+  METRICS_CALL(CALL_AVAILABLE);
+
+  // RX_P_NO is 0b111 while the RX FIFO is empty.
+  uint8_t number = get_status() >> RX_P_NO & 0b111;
+
+  if (number > 5) {
+    return false;
+  }
+
+  if (pipe) {
+    *pipe = number;
+  }
+
+  return true;
 }
 
 void Radio::read(void *buf, uint8_t len) {
+  METRICS_CALL(CALL_READ);
+
   read_payload(buf, len);
 
   write_register(STATUS, _BV(RX_DR) | _BV(MAX_RT) | _BV(TX_DS));
@@ -323,17 +1038,46 @@ uint8_t Radio::write_payload(const void *buf, uint8_t data_len, const uint8_t wr
   const uint8_t *current = reinterpret_cast<const uint8_t *>(buf);
 
   data_len = data_len < PAYLOAD_SIZE ? data_len : PAYLOAD_SIZE;
-  uint8_t blank_len = PAYLOAD_SIZE - data_len;
+  uint8_t blank_len = feature & _BV(EN_DPL) ? 0 : PAYLOAD_SIZE - data_len;
+
+  // ACK payloads are loaded in RX mode and only go out with an ACK.
+  if (!(config & _BV(PRIM_RX))) {
+    METRICS_START(PHASE_RADIO_TX);
+  }
+
+  csnLow();
+
+  uint8_t status = HalfDuplexSPI::byte(writeType);
+  HalfDuplexSPI::outBurst(current, data_len);
+
+  while (blank_len--) {
+    HalfDuplexSPI::out(0);
+  }
+
+  csnHigh();
+
+  return status;
+}
+
+uint8_t Radio::write_payload_P(const void *buf, uint8_t data_len, const uint8_t writeType) {
+  const uint8_t *current = reinterpret_cast<const uint8_t *>(buf);
+
+  data_len = data_len < PAYLOAD_SIZE ? data_len : PAYLOAD_SIZE;
+  uint8_t blank_len = feature & _BV(EN_DPL) ? 0 : PAYLOAD_SIZE - data_len;
+
+  if (!(config & _BV(PRIM_RX))) {
+    METRICS_START(PHASE_RADIO_TX);
+  }
 
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(writeType);
   while (data_len--) {
-    HalfDuplexSPI::byte(*current++);
+    HalfDuplexSPI::out(pgm_read_byte(current++));
   }
 
   while (blank_len--) {
-    HalfDuplexSPI::byte(0);
+    HalfDuplexSPI::out(0);
   }
 
   csnHigh();
@@ -345,17 +1089,15 @@ uint8_t Radio::read_payload(void *buf, uint8_t data_len) {
   uint8_t *current = reinterpret_cast<uint8_t *>(buf);
 
   data_len = data_len > PAYLOAD_SIZE ? PAYLOAD_SIZE : data_len;
-  uint8_t blank_len = PAYLOAD_SIZE - data_len;
+  uint8_t blank_len = feature & _BV(EN_DPL) ? 0 : PAYLOAD_SIZE - data_len;
 
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(R_RX_PAYLOAD);
-  while (data_len--) {
-    *current++ = HalfDuplexSPI::byte(0xFF);
-  }
+  HalfDuplexSPI::inBurst(current, data_len);
 
   while (blank_len--) {
-    HalfDuplexSPI::byte(0xff);
+    HalfDuplexSPI::in();
   }
 
   csnHigh();
@@ -365,14 +1107,23 @@ uint8_t Radio::read_payload(void *buf, uint8_t data_len) {
 
 void Radio::csnLow(void) {
   // Discharge SCK->CSN RC.
+  METRICS_COUNT(COUNT_TRANSACTIONS);
+  METRICS_START(PHASE_SPI);
+
   cbi(SPI_PORT, SPI_SCK);
-  _delay_us(50);
+  METRICS_START(PHASE_CSN_DELAY);
+  _delay_loop_2(csnDelay);
+  METRICS_STOP(PHASE_CSN_DELAY);
 }
 
 void Radio::csnHigh(void) {
   // Charge SCK->CSN RC.
   sbi(SPI_PORT, SPI_SCK);
-  _delay_us(50);
+  METRICS_START(PHASE_CSN_DELAY);
+  _delay_loop_2(csnDelay);
+  METRICS_STOP(PHASE_CSN_DELAY);
+
+  METRICS_STOP(PHASE_SPI);
 }
 
 uint8_t Radio::flush_rx(void) {
@@ -386,6 +1137,8 @@ uint8_t Radio::flush_rx(void) {
 }
 
 uint8_t Radio::flush_tx(void) {
+  METRICS_STOP(PHASE_RADIO_TX);
+
   csnLow();
 
   uint8_t status = HalfDuplexSPI::byte(FLUSH_TX);
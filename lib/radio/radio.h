@@ -1,6 +1,66 @@
 #ifndef SCOUT_RF_RADIO_H
 #define SCOUT_RF_RADIO_H
 
+#include <avr/io.h>
+#include "nRF24L01.h"
+
+// Maximum address width supported by the chip, actual width is configured via SETUP_AW.
+static const uint8_t ADDRESS_WIDTH = 5;
+
+/* SCK->CSN RC network, see docs/TDDSPI.png. CSN follows SCK once it's held long enough to charge or discharge C1.
+ *
+ * define CSN_RC_R (Ohm), CSN_RC_C (nF) and CSN_RC_TAU_PERCENT (share of the RC time constant to hold SCK) before
+ * including this file to match the board, and CSN_RC_CALIBRATE to let Radio::setup() find the shortest delay that
+ * still works on the actual board.
+ */
+#ifndef CSN_RC_R
+#define CSN_RC_R 470
+#endif
+
+#ifndef CSN_RC_C
+#define CSN_RC_C 220
+#endif
+
+#ifndef CSN_RC_TAU_PERCENT
+#define CSN_RC_TAU_PERCENT 50
+#endif
+
+// _delay_loop_2() takes 4 cycles per iteration.
+#define CSN_DELAY_LOOPS (1L * CSN_RC_R * CSN_RC_C * CSN_RC_TAU_PERCENT / 100 * (F_CPU / 1000000) / 4000)
+
+#if CSN_DELAY_LOOPS < 1 || CSN_DELAY_LOOPS > 65535
+#error CSN RC delay is out of _delay_loop_2() range
+#endif
+
+// Payloads in a row that have to be acknowledged on the first try before power control steps the output power down.
+#ifndef POWER_CONTROL_RUN
+#define POWER_CONTROL_RUN 8
+#endif
+
+// Time from power up to a valid RPD in RX mode: Tpd2stby for crystals up to 30mH, 130us RX settling, 40us RPD filter.
+// Modules with a 90mH crystal need up to 4500us of Tpd2stby instead.
+#ifndef RPD_SETTLE_US
+#define RPD_SETTLE_US (1500 + 130 + 40)
+#endif
+
+/* Optional nRF24L01+ IRQ line wired to a pin change capable PORTB pin, e.g. -DRADIO_IRQ=PB1. The MCU then sleeps
+ * until TX_DS, MAX_RT or RX_DR fire instead of polling STATUS, see Radio::waitForIrq(). The PCINT0 vector itself
+ * belongs to the application, it only has to exist so that the pin change can wake the MCU up.
+ */
+
+// RF channels 0-125, Radio::surveyChannels() keeps a 4-bit count per channel.
+static const uint8_t CHANNELS = 126;
+static const uint8_t CHANNEL_MAP_SIZE = CHANNELS / 2;
+
+/**
+ * Interrupt sources as reported by Radio::waitForIrq(), bit values match STATUS.
+ */
+enum IrqEvent {
+  IRQ_TX_FAILED = _BV(MAX_RT),
+  IRQ_TX_SENT = _BV(TX_DS),
+  IRQ_RX_READY = _BV(RX_DR)
+};
+
 enum OutputPower {
   MIN = 0,
   LOW,
@@ -14,10 +74,106 @@ enum DataRate {
   RATE_250KBPS
 };
 
+enum CrcLength {
+  CRC_DISABLED = 0,
+  CRC_8,
+  CRC_16
+};
+
+/**
+ * Compile-time radio configuration profile
+ *
+ * Folds the final register image at compile time, so that Radio::setup<Profile>() only pushes constants to the chip
+ * instead of running a chain of read-modify-write setters.
+ *
+ * @code
+ * typedef RadioProfile<1, RATE_250KBPS, HIGH, 2, 15> ScoutProfile;
+ * radio.setup<ScoutProfile>();
+ * @endcode
+ *
+ * @tparam channel RF channel, 0-125
+ * @tparam rate Data rate
+ * @tparam power RF output power level
+ * @tparam retryDelay Auto retransmit delay in multiples of 250us, 0-15
+ * @tparam retryCount Auto retransmit count, 0-15
+ * @tparam crc CRC length, must be enabled if auto-ack is enabled on any pipe
+ * @tparam addressWidth Address width in bytes, 3-5
+ * @tparam pipes Bit mask of enabled RX pipes, see EN_RXADDR
+ * @tparam autoAckPipes Bit mask of pipes with auto-ack enabled, see EN_AA
+ * @tparam dynamicPayloadPipes Bit mask of pipes with dynamic payload length, see DYNPD
+ * @tparam ackPayloads Whether ACKs carry payloads, see Radio::writeAckPayload()
+ */
+template<uint8_t channel, DataRate rate, OutputPower power, uint8_t retryDelay, uint8_t retryCount,
+    CrcLength crc = CRC_16, uint8_t addressWidth = ADDRESS_WIDTH, uint8_t pipes = _BV(ERX_P0) | _BV(ERX_P1),
+    uint8_t autoAckPipes = 0b111111, uint8_t dynamicPayloadPipes = 0, bool ackPayloads = false>
+struct RadioProfile {
+  static_assert(channel <= 125, "Channel must be 0-125");
+  static_assert(retryDelay <= 15 && retryCount <= 15, "Retry delay and count must be 0-15");
+  static_assert(addressWidth >= 3 && addressWidth <= ADDRESS_WIDTH, "Address width must be 3-5 bytes");
+  static_assert(crc != CRC_DISABLED || autoAckPipes == 0, "Auto-ack requires CRC");
+  static_assert(!(dynamicPayloadPipes & ~autoAckPipes), "Dynamic payload length requires auto-ack");
+  static_assert(!ackPayloads || (dynamicPayloadPipes & _BV(DPL_P0)),
+                "ACK payloads require dynamic payload length on pipe 0");
+  static_assert(!ackPayloads || rate != RATE_250KBPS || retryDelay >= 5,
+                "ACK payloads at 250KBPS require at least 1500us retry delay");
+
+  static constexpr uint8_t config =
+      (crc != CRC_DISABLED ? _BV(EN_CRC) : 0) | (crc == CRC_16 ? _BV(CRCO) : 0) | _BV(PWR_UP);
+  static constexpr uint8_t enAA = autoAckPipes;
+  static constexpr uint8_t enRxAddr = pipes;
+  static constexpr uint8_t setupAw = addressWidth - 2;
+  static constexpr uint8_t setupRetr = retryDelay << ARD | retryCount << ARC;
+  static constexpr uint8_t rfCh = channel;
+  static constexpr uint8_t rfSetup =
+      (rate == RATE_250KBPS ? _BV(RF_DR_LOW) : rate == RATE_2MBPS ? _BV(RF_DR_HIGH) : 0) | ((power << 1) + 1);
+  static constexpr uint8_t feature = (dynamicPayloadPipes ? _BV(EN_DPL) : 0) | (ackPayloads ? _BV(EN_ACK_PAY) : 0);
+  static constexpr uint8_t dynpd = dynamicPayloadPipes;
+  static constexpr uint32_t txRxDelay = rate == RATE_250KBPS ? 155 : rate == RATE_2MBPS ? 65 : 85;
+};
+
 class Radio {
+  // Cycle-accurate microbenchmarks reach into private SPI helpers, see src/bench.cpp.
+  friend class RadioBench;
+
 public:
+  /**
+   * Set the chip up with the default profile: channel 76, 1Mbps, max power, 1500us/15 retries, 16-bit CRC.
+   *
+   * @return True if the chip responds and accepted the configuration
+   */
+  bool setup(void);
+
+  /**
+   * Set the chip up with a compile-time configuration profile
+   *
+   * The register image is folded at compile time and pushed as a write-only sequence, CONFIG goes last so the chip
+   * stays powered down until the whole configuration is in place. A single RF_SETUP read verifies the result, which
+   * also catches non-plus modules that don't support 250KBPS.
+   *
+   * @see RadioProfile
+   * @return True if the chip responds and accepted the configuration
+   */
+  template<typename Profile>
   bool setup(void);
 
+  /**
+   * Check that the chip still holds the configuration Radio believes it has
+   *
+   * Reads back every shadowed register and pipe address and compares it with the local copy.
+   * Use it to detect a brownout or a reset of the nRF24L01+ behind our back.
+   *
+   * @return True if the chip matches the local shadow, false otherwise
+   */
+  bool verify(void);
+
+  /**
+   * Push the whole local shadow to the chip
+   *
+   * Unconditionally rewrites every shadowed register and pipe address, e.g. to recover after
+   * verify() has detected a brownout.
+   */
+  void resync(void);
+
   /**
    * Retrieve the current status of the chip
    *
@@ -61,6 +217,16 @@ public:
    */
   uint8_t write_register(uint8_t reg, const uint8_t* buf, uint8_t len);
 
+  /**
+   * Write a chunk of data from flash to a register
+   *
+   * @param reg Which register. Use constants from nRF24L01.h
+   * @param buf Where to get the data, in PROGMEM
+   * @param len How many bytes of data to transfer
+   * @return Current value of status register
+   */
+  uint8_t write_register_P(uint8_t reg, const uint8_t* buf, uint8_t len);
+
   /**
    * Write a single byte to a register
    *
@@ -79,6 +245,32 @@ public:
    */
   void setRetries(uint8_t delay, uint8_t count);
 
+  /**
+   * Retransmits of the last payload, ARC_CNT of OBSERVE_TX
+   *
+   * @return 0-15, equals the retry count if the payload ran out of retries
+   */
+  uint8_t getRetransmits(void);
+
+  /**
+   * Payloads that ran out of retries, PLOS_CNT of OBSERVE_TX
+   *
+   * @return 0-15, saturates at 15 and is reset when setChannel() changes the channel
+   */
+  uint8_t getLostPackets(void);
+
+  /**
+   * Find the shortest CSN RC delay that still gives reliable register access
+   *
+   * Binary searches delays below the compile-time CSN_DELAY_LOOPS, alternately reading back RF_SETUP and RF_CH and
+   * comparing them with the shadow, then keeps the result with a 25% margin for every following transaction.
+   * Registers the search may have corrupted are restored from the shadow afterwards. Called by setup() when
+   * CSN_RC_CALIBRATE is defined.
+   *
+   * @return Calibrated delay in _delay_loop_2() iterations, 0 if even the compile-time delay doesn't work
+   */
+  uint16_t calibrateCsnDelay(void);
+
   /**
    * Sets RF output power level.
    *
@@ -89,15 +281,71 @@ public:
    */
   void setOutputPower(OutputPower power);
 
+  /**
+   * @return Current output power
+   */
+  OutputPower getOutputPower(void);
+
+  /**
+   * Turn closed-loop output power control on
+   *
+   * Starts from the level stored in EEPROM by a previous run, or keeps the current one if nothing is stored yet.
+   * From then on txStandBy() and write() step the power up whenever a payload runs out of retries, and down after
+   * POWER_CONTROL_RUN payloads in a row have been acknowledged without a retransmit. Levels are stored in EEPROM
+   * once a payload has been acknowledged on the channel, so the next power cycle starts from the lowest level that
+   * worked. A channel without the hub fails every payload too, so setChannel() goes back to the stored level.
+   *
+   * @note setup() turns power control off, call this afterwards.
+   */
+  void enablePowerControl(void);
+
   bool setDataRate(DataRate rate);
 
   /**
    * Set RF communication channel
    *
+   * With power control on, a change of channel restores the output power stored in EEPROM, see enablePowerControl().
+   *
    * @param channel Which RF channel to communicate on, 0-125
    */
   void setChannel(uint8_t channel);
 
+  /**
+   * Test whether there is a carrier above -64dBm on the current channel
+   *
+   * Only meaningful in RX mode, at least RPD_SETTLE_US after entering it.
+   *
+   * @return RPD bit
+   */
+  bool testRpd(void);
+
+  /**
+   * Sweep channels 0-125 in RX mode and count how often RPD reports a carrier on each of them
+   *
+   * Takes about CHANNELS * RPD_SETTLE_US, i.e. 0.2s by default. Channel and mode are restored afterwards, anything
+   * received meanwhile is flushed.
+   *
+   * @param map CHANNEL_MAP_SIZE bytes, a 4-bit count per channel, even channels in the low nibble
+   * @param samples RPD samples per channel, 1-15
+   */
+  void surveyChannels(uint8_t *map, uint8_t samples);
+
+  /**
+   * @param map Result of surveyChannels()
+   * @param channel 0-125
+   * @return Samples that reported a carrier on @p channel
+   */
+  static uint8_t channelOccupancy(const uint8_t *map, uint8_t channel);
+
+  /**
+   * Order channels from the quietest one, equally quiet channels keep their order
+   *
+   * @param map Result of surveyChannels()
+   * @param channels Channels to order in place
+   * @param count Number of @p channels
+   */
+  static void rankChannels(const uint8_t *map, uint8_t *channels, uint8_t count);
+
   /**
    * Enter low-power mode
    *
@@ -146,6 +394,105 @@ public:
    */
   void setAutoAck(uint8_t pipe, bool enable);
 
+  /**
+   * Select which events assert the IRQ line
+   *
+   * All of them are enabled after setup().
+   *
+   * @param txSent Whether TX_DS (successful transmission) asserts IRQ
+   * @param txFailed Whether MAX_RT (retries ran out) asserts IRQ
+   * @param rxReady Whether RX_DR (payload received) asserts IRQ
+   */
+  void setInterruptMask(bool txSent, bool txFailed, bool rxReady);
+
+#ifdef RADIO_IRQ
+  /**
+   * Sleep in power down until the IRQ line is asserted
+   *
+   * Reported flags are cleared on the chip, which releases the IRQ line. On MAX_RT the TX FIFO is flushed first, with
+   * CE tied high clearing the flag would start the failed payload over.
+   *
+   * @warning Only returns once an unmasked event fires. With auto-ack a transmission always ends with TX_DS or MAX_RT.
+   * @return Bit mask of IrqEvent that fired
+   */
+  uint8_t waitForIrq(void);
+
+  /**
+   * Write a payload and sleep until it's either delivered or retries run out
+   *
+   * A failed payload is flushed from the TX FIFO.
+   *
+   * @param buf Pointer to the data to be sent
+   * @param len Number of bytes to be sent
+   * @return Bit mask of IrqEvent that fired, IRQ_TX_SENT on success
+   */
+  uint8_t write(const void *buf, uint8_t len);
+#endif
+
+  /**
+   * Enable dynamic payload length on all pipes
+   *
+   * Only the bytes actually passed to write() are clocked out and sent over the air, instead of a payload padded
+   * to 32 bytes. Both ends must enable it, and it requires auto-ack on the pipes in use.
+   *
+   * @see setDynamicPayload()
+   * @see getDynamicPayloadSize()
+   */
+  void enableDynamicPayloads(void);
+
+  /**
+   * Select fixed or dynamic payload length on a per pipeline basis
+   *
+   * @param pipe Which pipeline to modify, 0-5
+   * @param enable Whether to use dynamic (true) or fixed (false) payload length
+   */
+  void setDynamicPayload(uint8_t pipe, bool enable);
+
+  /**
+   * Get the length of the payload at the top of the RX FIFO, when dynamic payload length is enabled
+   *
+   * @code
+   * if (radio.available()) {
+   *   uint8_t len = radio.getDynamicPayloadSize();
+   *   radio.read(&data, len);
+   * }
+   * @endcode
+   * @return Payload length in bytes, 0 if the payload was corrupted and has been flushed
+   */
+  uint8_t getDynamicPayloadSize(void);
+
+  /**
+   * Enable payloads in ACK packets, together with dynamic payload length on pipes 0 and 1
+   *
+   * The PTX then gets the reply in the same exchange as its own payload: once write() or txStandBy() report
+   * success, the ACK payload is already in the RX FIFO, read it with available() and read() without ever leaving
+   * TX mode. Both ends must enable it. At 250KBPS the retry delay must be at least 1500us.
+   *
+   * @see writeAckPayload()
+   */
+  void enableAckPayload(void);
+
+  /**
+   * Preload the payload of the next ACK sent on a pipe, PRX side
+   *
+   * Up to 3 ACK payloads can be pending, each goes out with the next packet received on its pipe. Load the reply
+   * before the PTX sends, i.e. one payload ahead, and after startListening(), which flushes the TX FIFO.
+   *
+   * @param pipe Pipe the ACK is sent on, 0-5
+   * @param buf Pointer to the data to be sent
+   * @param len Number of bytes to be sent, up to 32
+   */
+  void writeAckPayload(uint8_t pipe, const void *buf, uint8_t len);
+
+  /**
+   * Same as writeAckPayload(), with the payload in flash
+   *
+   * @param pipe Pipe the ACK is sent on, 0-5
+   * @param buf Pointer to the data to be sent, in PROGMEM
+   * @param len Number of bytes to be sent, up to 32
+   */
+  void writeAckPayload_P(uint8_t pipe, const void *buf, uint8_t len);
+
   /**
    * Open a pipe for writing via byte array.
    *
@@ -171,6 +518,13 @@ public:
    */
   void openWritingPipe(const uint8_t *address);
 
+  /**
+   * Same as openWritingPipe(), with the address in flash
+   *
+   * @param address The address of the pipe to open, in PROGMEM
+   */
+  void openWritingPipe_P(const uint8_t *address);
+
   /**
    * Open a pipe for reading
    *
@@ -195,10 +549,43 @@ public:
    * pipe 0 for reading, and then startListening(), it will overwrite the
    * writing pipe.  Ergo, do an openWritingPipe() again before write().
    *
+   * @param pipe Which pipe to open, 0-5
+   * @param address The 24, 32 or 40 bit address of the pipe to open, only the first byte is used for pipes 2-5.
+   */
+  void openReadingPipe(uint8_t pipe, const uint8_t *address);
+
+  /**
+   * Same as openReadingPipe(), with the address in flash
+   *
+   * @param pipe Which pipe to open, 0-5
+   * @param address The address of the pipe to open, in PROGMEM
+   */
+  void openReadingPipe_P(uint8_t pipe, const uint8_t *address);
+
+  /**
+   * Open pipe 1 for reading
+   *
    * @param address The 24, 32 or 40 bit address of the pipe to open.
    */
   void openReadingPipe(const uint8_t *address);
 
+  /**
+   * Stop receiving on a pipe, its address is kept
+   *
+   * @param pipe Which pipe to close, 0-5
+   */
+  void closeReadingPipe(uint8_t pipe);
+
+  /**
+   * Set the payload width of a pipe, only used while dynamic payload length is off on that pipe
+   *
+   * openReadingPipe() sets 32 bytes.
+   *
+   * @param pipe Which pipe to modify, 0-5
+   * @param size Payload width in bytes, 1-32
+   */
+  void setPayloadSize(uint8_t pipe, uint8_t size);
+
   /**
    * Start listening on the pipes opened for reading.
    *
@@ -219,7 +606,8 @@ public:
   /**
    * Stop listening for incoming messages, and switch to transmit mode.
    *
-   * Do this before calling write().
+   * Do this before calling write(). Free if the radio is in transmit mode already, otherwise it takes two CONFIG
+   * writes and doesn't wait for the radio to settle, the first payload just goes out later.
    * @code
    * radio.stopListening();
    * radio.write(&data,sizeof(data));
@@ -302,9 +690,8 @@ public:
   /**
    * Non-blocking write to the open writing pipe used for buffered writes
    *
-   * @note Optimization: This function now leaves the CE pin high, so the radio
-   * will remain in TX or STANDBY-II Mode until a txStandBy() command is issued. Can be used as an alternative to startWrite()
-   * if writing multiple payloads at once.
+   * @note CE is tied high, so a powered up PTX sends the payload as soon as it's in the TX FIFO and stays in TX or
+   * STANDBY-II mode until the FIFO is empty. @p startTx has no effect.
    * @warning It is important to never keep the nRF24L01 in TX mode with FIFO full for more than 4ms at a time. If the auto
    * retransmit/autoAck is enabled, the nRF24L01 is never in TX mode long enough to disobey this rule. Allow the FIFO
    * to clear by issuing txStandBy() or ensure appropriate time between transmissions.
@@ -321,10 +708,39 @@ public:
    * @param buf Pointer to the data to be sent
    * @param len Number of bytes to be sent
    * @param multicast Request ACK (0) or NOACK (1)
-   * @return True if the payload was delivered successfully false if not
+   * @param startTx Ignored, kept for compatibility
    */
   void startFastWrite( const void* buf, uint8_t len, const bool multicast, bool startTx = 1 );
 
+  /**
+   * Send up to 8 payloads back to back, keeping the TX FIFO filled
+   *
+   * With auto-ack all 3 FIFO slots are kept busy, the radio leaves TX mode for every ACK, so the 4ms rule can't be
+   * broken. With @p multicast the radio would stay in TX mode from one payload to the next, so the FIFO is only
+   * refilled once it's empty and with no more payloads than go out within 4ms at the current data rate.
+   *
+   * A payload that runs out of retries is dropped and the rest are queued again, so one bad payload doesn't block
+   * the others.
+   *
+   * Payloads are told apart by counting TX_DS, which the radio sets once for any number of payloads. Each poll
+   * reads and clears it in one transaction, so nothing is lost as long as payloads are further apart than a poll,
+   * which holds at 250kbps. At 1-2Mbps with short payloads two can complete within a poll, then a payload that runs
+   * out of retries afterwards may be reported in place of a delivered one before it, and the mask under-reports.
+   *
+   * @code
+   * const void *payloads[] = {&event1, &event2, &event3, &event4};
+   * uint8_t lengths[] = {5, 5, 5, 5};
+   * uint8_t delivered = radio.writeMany(payloads, lengths, 4);
+   * @endcode
+   *
+   * @param payloads Pointers to the payloads
+   * @param lengths Length of each payload, up to 32 bytes
+   * @param count Number of payloads, up to 8
+   * @param multicast Request ACK (0) or NOACK (1)
+   * @return Bit mask of delivered payloads, bit n for payloads[n]. Without ACK it's the ones that went out.
+   */
+  uint8_t writeMany(const void *const *payloads, const uint8_t *lengths, uint8_t count, bool multicast = false);
+
   /**
    * This function should be called as soon as transmission is finished to
    * drop the radio back to STANDBY-I mode. If not issued, the radio will
@@ -382,6 +798,22 @@ public:
    */
   bool available(void);
 
+  /**
+   * Check whether there are bytes available to be read, and on which pipe
+   *
+   * Takes a single STATUS byte, the pipe is that of the payload read() returns next.
+   * @code
+   * uint8_t pipe;
+   * if (radio.available(&pipe)) {
+   *   radio.read(&data[pipe], sizeof(data[pipe]));
+   * }
+   * @endcode
+   *
+   * @param pipe Where to put the pipe number, 0-5, left untouched if nothing is available
+   * @return True if there is a payload available, false if none is
+   */
+  bool available(uint8_t *pipe);
+
   /**
    * Read the available payload
    *
@@ -408,11 +840,90 @@ public:
 
 private:
   uint32_t txRxDelay; /**< Var for adjusting delays depending on datarate */
+  uint16_t csnDelay; /**< SCK->CSN RC delay in _delay_loop_2() iterations, see calibrateCsnDelay() */
+
+  /**
+   * RAM shadow of the configuration registers. Every write goes through update_register() so that
+   * read-modify-write sequences are served locally and unchanged values never reach the SPI bus.
+   */
+  uint8_t config;
+  uint8_t enAA;
+  uint8_t enRxAddr;
+  uint8_t setupAw;
+  uint8_t setupRetr;
+  uint8_t rfCh;
+  uint8_t rfSetup;
+  uint8_t feature;
+  uint8_t dynpd;
+  uint8_t rxPayloadWidth[6];
+  uint8_t rxAddress[2][ADDRESS_WIDTH];
+  uint8_t rxAddressByte[4]; /**< Pipes 2-5, the other bytes come from pipe 1 */
+  uint8_t txAddress[ADDRESS_WIDTH];
+
+  bool powerControl; /**< See enablePowerControl() */
+  uint8_t firstTryAcks; /**< Payloads acknowledged without a retransmit in a row */
+  bool linked; /**< A payload has been acknowledged since the channel was set */
+
+  /**
+   * Write a single byte register only if it differs from its shadow copy
+   *
+   * @param reg Which register. Use constants from nRF24L01.h
+   * @param shadow Shadow copy of @p reg
+   * @param value The new value to write
+   */
+  void update_register(uint8_t reg, uint8_t &shadow, uint8_t value);
+
+  /**
+   * Write an address register only if it differs from its shadow copy
+   *
+   * @param reg Which register. Use constants from nRF24L01.h
+   * @param shadow Shadow copy of @p reg, ADDRESS_WIDTH bytes
+   * @param address The new address, ADDRESS_WIDTH bytes
+   * @param progmem True if @p address is in PROGMEM
+   */
+  void update_address(uint8_t reg, uint8_t *shadow, const uint8_t *address, bool progmem = false);
+
+  /**
+   * Shared by openReadingPipe() and openReadingPipe_P()
+   */
+  void open_reading_pipe(uint8_t pipe, const uint8_t *address, bool progmem);
+
+  /**
+   * Current address width in bytes, as configured in SETUP_AW
+   */
+  uint8_t address_width(void);
+
+  /**
+   * Time a payload takes on air at the current data rate, address width and CRC, without ACK
+   *
+   * @param len Payload length in bytes
+   * @return Airtime in us, including 130us TX settling
+   */
+  uint16_t payload_airtime(uint8_t len);
+
+  /**
+   * Feed the outcome of a payload to power control, does nothing unless it's enabled
+   *
+   * @param sent True if the payload has been acknowledged, false if it ran out of retries
+   */
+  void adapt_power(bool sent);
+
+  /**
+   * Go back to the output power stored in EEPROM and wait for an ACK before storing changes again
+   */
+  void restore_power(void);
+
+  /**
+   * Bring the chip to the configuration held in the register shadow, used by setup()
+   *
+   * @return True if the chip responds and accepted the configuration
+   */
+  bool setup_shadow(void);
 
   /**
    * Write the transmit payload
    *
-   * The size of data written is the fixed payload size, see getPayloadSize()
+   * The size of data written is the fixed payload size, or exactly @p len if dynamic payload length is enabled
    *
    * @param buf Where to get the data
    * @param len Number of bytes to be sent
@@ -420,10 +931,21 @@ private:
    */
   uint8_t write_payload(const void* buf, uint8_t len, const uint8_t writeType);
 
+  /**
+   * Same as write_payload(), with the payload in flash
+   *
+   * Bytes are read from flash one by one, so it clocks slower than the RAM burst. Meant for short constant payloads.
+   *
+   * @param buf Where to get the data, in PROGMEM
+   * @param len Number of bytes to be sent
+   * @return Current value of status register
+   */
+  uint8_t write_payload_P(const void* buf, uint8_t len, const uint8_t writeType);
+
   /**
    * Read the receive payload
    *
-   * The size of data read is the fixed payload size, see getPayloadSize()
+   * The size of data read is the fixed payload size, or exactly @p len if dynamic payload length is enabled
    *
    * @param buf Where to put the data
    * @param len Maximum number of bytes to read
@@ -434,6 +956,14 @@ private:
   void csnLow(void);
   void csnHigh(void);
 
+  /**
+   * Check whether register access is reliable with the given CSN RC delay
+   *
+   * @param delay CSN RC delay in _delay_loop_2() iterations
+   * @return True if all read backs match the shadow
+   */
+  bool csn_delay_works(uint16_t delay);
+
   /**
   * Empty the receive buffer
   *
@@ -467,5 +997,20 @@ private:
   void reUseTX(void);
 };
 
+template<typename Profile>
+bool Radio::setup(void) {
+  config = Profile::config;
+  enAA = Profile::enAA;
+  enRxAddr = Profile::enRxAddr;
+  setupAw = Profile::setupAw;
+  setupRetr = Profile::setupRetr;
+  rfCh = Profile::rfCh;
+  rfSetup = Profile::rfSetup;
+  feature = Profile::feature;
+  dynpd = Profile::dynpd;
+  txRxDelay = Profile::txRxDelay;
+
+  return setup_shadow();
+}
 
 #endif //SCOUT_RF_RADIO_H
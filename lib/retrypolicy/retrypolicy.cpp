@@ -0,0 +1,92 @@
+#include "radio.h"
+#include "retrypolicy.h"
+
+// Gives the average a weight of 3/4, i.e. about the last 4 payloads count.
+static const uint8_t AVERAGE_SHIFT = 2;
+
+// Sessions without reply halve maxAttempts() at most this many times.
+static const uint8_t MAX_MISSED = 3;
+
+RetryPolicy::RetryPolicy(uint8_t minDelay) : minDelay(minDelay), average(0), failures(0), missed(0), state(1) {
+}
+
+void RetryPolicy::seed(uint16_t value) {
+  // xorshift never leaves 0.
+  state = value ? value : 1;
+}
+
+void RetryPolicy::sent(uint8_t retransmits) {
+  failures = 0;
+
+  average = average - (average >> AVERAGE_SHIFT) + ((retransmits & 0xf) << 4 >> AVERAGE_SHIFT);
+}
+
+void RetryPolicy::failed(void) {
+  if (failures < 0xff) {
+    failures++;
+  }
+}
+
+void RetryPolicy::finished(bool delivered) {
+  if (delivered) {
+    missed = 0;
+  } else if (missed < MAX_MISSED) {
+    missed++;
+  }
+}
+
+uint8_t RetryPolicy::retryDelay(void) const {
+  // Many retransmits usually mean interference or collisions, waiting longer between them gets out of the way.
+  uint8_t delay = minDelay + (average >> 6);
+
+  return delay > 15 ? 15 : delay;
+}
+
+uint8_t RetryPolicy::retryCount(void) const {
+  // First failure may just mean the count was too tight, every further one means the link is gone for now and
+  // hardware retries are wasted airtime, backoff() spaces attempts out instead.
+  if (failures == 1) {
+    return 15;
+  }
+
+  if (failures) {
+    uint8_t count = failures < 5 ? 15 >> (failures - 1) : 0;
+    return count ? count : 1;
+  }
+
+  // Twice the average plus a margin of 2, so a good link needs one quick attempt.
+  uint8_t count = (average >> 3) + 2;
+
+  return count > 15 ? 15 : count;
+}
+
+void RetryPolicy::apply(Radio &radio) const {
+  radio.setRetries(retryDelay(), retryCount());
+}
+
+uint8_t RetryPolicy::maxAttempts(void) const {
+  uint8_t attempts = RETRY_MAX_ATTEMPTS >> missed;
+
+  return attempts > 2 ? attempts : 2;
+}
+
+uint16_t RetryPolicy::backoff(uint8_t attempts) {
+  uint8_t shift = attempts > 1 ? attempts - 1 : 0;
+  uint16_t step = RETRY_BACKOFF_MAX;
+
+  if (shift < 16 && (RETRY_BACKOFF_MAX >> shift) >= RETRY_BACKOFF_MIN) {
+    step = RETRY_BACKOFF_MIN << shift;
+  }
+
+  uint16_t half = step >> 1;
+
+  return step - half + ((uint32_t) random() * half >> 16);
+}
+
+uint16_t RetryPolicy::random(void) {
+  state ^= state << 7;
+  state ^= state >> 9;
+  state ^= state << 8;
+
+  return state;
+}
@@ -0,0 +1,113 @@
+#ifndef SCOUT_RF_RETRYPOLICY_H
+#define SCOUT_RF_RETRYPOLICY_H
+
+#include <avr/io.h>
+
+/* Adaptive retries for a single link
+ *
+ * Tunes the hardware auto retransmit (ARD/ARC) and the application level backoff from what the link did recently:
+ * an average of retransmits per acknowledged payload, taken from OBSERVE_TX, a streak of payloads that ran out of
+ * retries and a streak of sessions that never got a reply.
+ *
+ * Good links get few hardware retries, a short first wait and finish in one attempt. On a bad link hardware retries
+ * are cut down once they keep failing, waits grow exponentially with jitter so nodes don't collide over and over, and
+ * sessions give up sooner while the other side stays silent.
+ *
+ * @code
+ * policy.apply(radio);
+ * if (radio.writeFast(&data, 5) && radio.txStandBy()) {
+ *   policy.sent(radio.getRetransmits());
+ * } else {
+ *   policy.failed();
+ * }
+ * Scheduler::setTimer(TIMER_PING, policy.backoff(attempts), EVENT_PONG_TIMEOUT);
+ * @endcode
+ *
+ * define RETRY_MAX_ATTEMPTS, RETRY_BACKOFF_MIN and RETRY_BACKOFF_MAX before including this file to change the limits.
+ */
+
+#ifndef RETRY_MAX_ATTEMPTS
+#define RETRY_MAX_ATTEMPTS 10
+#endif
+
+// First wait in ms, doubled with every further attempt up to RETRY_BACKOFF_MAX.
+#ifndef RETRY_BACKOFF_MIN
+#define RETRY_BACKOFF_MIN 250
+#endif
+
+#ifndef RETRY_BACKOFF_MAX
+#define RETRY_BACKOFF_MAX 8000
+#endif
+
+class Radio;
+
+class RetryPolicy {
+public:
+  /**
+   * @param minDelay Shortest ARD that fits the data rate and ACK size, in multiples of 250us, see setRetries()
+   */
+  RetryPolicy(uint8_t minDelay);
+
+  /**
+   * Seed the jitter, nodes running the same firmware must be seeded with something that differs between them
+   */
+  void seed(uint16_t value);
+
+  /**
+   * Payload has been acknowledged
+   *
+   * @param retransmits ARC_CNT of the payload, see Radio::getRetransmits()
+   */
+  void sent(uint8_t retransmits);
+
+  /**
+   * Payload ran out of hardware retries
+   */
+  void failed(void);
+
+  /**
+   * Session, i.e. a series of attempts, is over
+   *
+   * @param delivered Whether the other side replied
+   */
+  void finished(bool delivered);
+
+  /**
+   * @return ARD for the next payload, in multiples of 250us
+   */
+  uint8_t retryDelay(void) const;
+
+  /**
+   * @return ARC for the next payload, 1-15
+   */
+  uint8_t retryCount(void) const;
+
+  /**
+   * Write retryDelay() and retryCount() to the radio, free if they didn't change
+   */
+  void apply(Radio &radio) const;
+
+  /**
+   * @return How many attempts a session may make
+   */
+  uint8_t maxAttempts(void) const;
+
+  /**
+   * Randomized exponential backoff, uniformly distributed over the upper half of the exponential step
+   *
+   * @param attempts Attempts made so far in the current session, 1 or more
+   * @return How long to wait before the next attempt in ms
+   */
+  uint16_t backoff(uint8_t attempts);
+
+private:
+  uint8_t minDelay;
+  uint8_t average;  /**< Retransmits per acknowledged payload, 4 fractional bits */
+  uint8_t failures; /**< Payloads that ran out of retries in a row */
+  uint8_t missed;   /**< Sessions without reply in a row */
+  uint16_t state;   /**< xorshift state of the jitter */
+
+  uint16_t random(void);
+};
+
+#endif //SCOUT_RF_RETRYPOLICY_H
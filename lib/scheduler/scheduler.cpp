@@ -0,0 +1,124 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "lowpower.h"
+#include "scheduler.h"
+
+Event Scheduler::queue[SCHEDULER_QUEUE_SIZE];
+volatile uint8_t Scheduler::head = 0;
+volatile uint8_t Scheduler::count = 0;
+
+uint32_t Scheduler::remaining[SCHEDULER_TIMERS];
+Event Scheduler::timerEvent[SCHEDULER_TIMERS];
+uint32_t Scheduler::clock = 0;
+bool Scheduler::ticking = false;
+
+bool Scheduler::post(Event event) {
+  if (!push(event)) {
+    return false;
+  }
+
+  LowPower::wake();
+
+  return true;
+}
+
+bool Scheduler::push(Event event) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (count == SCHEDULER_QUEUE_SIZE) {
+      return false;
+    }
+
+    queue[(head + count) % SCHEDULER_QUEUE_SIZE] = event;
+    count++;
+  }
+
+  return true;
+}
+
+bool Scheduler::next(Event &event) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (!count) {
+      return false;
+    }
+
+    event = queue[head];
+    head = (head + 1) % SCHEDULER_QUEUE_SIZE;
+    count--;
+  }
+
+  return true;
+}
+
+void Scheduler::setTimer(uint8_t timer, uint32_t ms, Event event) {
+  // Shorter than the shortest sleep, expire right away.
+  if (!ms) {
+    remaining[timer] = 0;
+    post(event);
+    return;
+  }
+
+  remaining[timer] = ms;
+  timerEvent[timer] = event;
+}
+
+void Scheduler::cancelTimer(uint8_t timer) {
+  remaining[timer] = 0;
+}
+
+bool Scheduler::isTimerArmed(uint8_t timer) {
+  return remaining[timer] != 0;
+}
+
+void Scheduler::sleep(void) {
+  bool armed = false;
+
+  for (uint8_t timer = 0; timer < SCHEDULER_TIMERS; timer++) {
+    armed |= remaining[timer] != 0;
+  }
+
+  // Nothing to time, sleep with WDT off until the next interrupt posts something.
+  if (!armed) {
+    if (ticking) {
+      LowPower::stopTicks();
+      ticking = false;
+    }
+
+    LowPower::sleep();
+    return;
+  }
+
+  // The WDT can't be read, so a running period is never restarted, that would lose its elapsed part. It keeps
+  // running across wake ups and this sleep waits for the rest of it.
+  if (!ticking) {
+    LowPower::startTicks(SCHEDULER_TICK_PRESCALER);
+    ticking = true;
+  }
+
+  uint8_t ticks = LowPower::sleepTick();
+  if (ticks) {
+    elapse(LowPower::period(SCHEDULER_TICK_PRESCALER) * ticks);
+  }
+}
+
+uint32_t Scheduler::now(void) {
+  return clock;
+}
+
+void Scheduler::elapse(uint32_t ms) {
+  clock += ms;
+
+  for (uint8_t timer = 0; timer < SCHEDULER_TIMERS; timer++) {
+    if (!remaining[timer]) {
+      continue;
+    }
+
+    if (remaining[timer] > ms) {
+      remaining[timer] -= ms;
+    } else {
+      // We're awake already, no need for wake().
+      remaining[timer] = 0;
+      push(timerEvent[timer]);
+    }
+  }
+}
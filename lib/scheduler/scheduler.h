@@ -0,0 +1,133 @@
+#ifndef SCOUT_RF_SCHEDULER_H
+#define SCOUT_RF_SCHEDULER_H
+
+#include <avr/io.h>
+
+/* Cooperative event scheduler with static allocation
+ *
+ * Events are small application defined codes, posted from interrupt handlers, timers or the application itself and
+ * handled one by one from the main loop. When the queue is empty the MCU sleeps in power down until the nearest
+ * timer expires or a new event is posted.
+ *
+ * @code
+ * ISR(PCINT0_vect) {
+ *   Scheduler::post(EVENT_LIGHT);
+ * }
+ *
+ * while (true) {
+ *   Event event;
+ *   while (Scheduler::next(event)) {
+ *     handle(event);
+ *   }
+ *
+ *   Scheduler::sleep();
+ * }
+ * @endcode
+ *
+ * define SCHEDULER_QUEUE_SIZE and SCHEDULER_TIMERS before including this file to resize the static storage.
+ *
+ * While any timer is armed, time advances in ticks of a fixed WDT period, SCHEDULER_TICK_PRESCALER. A shorter timer
+ * runs late up to the next tick, a longer tick saves wake ups at the cost of resolution.
+ */
+
+#ifndef SCHEDULER_QUEUE_SIZE
+#define SCHEDULER_QUEUE_SIZE 8
+#endif
+
+#ifndef SCHEDULER_TIMERS
+#define SCHEDULER_TIMERS 4
+#endif
+
+// WDT prescaler of the tick, period is 16ms * 2^n, 2 matches EVENT_TICK_MS.
+#ifndef SCHEDULER_TICK_PRESCALER
+#define SCHEDULER_TICK_PRESCALER 2
+#endif
+
+typedef uint8_t Event;
+
+class Scheduler {
+public:
+  /**
+   * Queue an event and wake the MCU up, safe to call from interrupt handlers
+   *
+   * @param event Application defined event code
+   * @return False if the queue is full and the event has been dropped
+   */
+  static bool post(Event event);
+
+  /**
+   * Take the oldest event off the queue
+   *
+   * @param event Where to put the event
+   * @return False if the queue is empty
+   */
+  static bool next(Event &event);
+
+  /**
+   * Arm a one-shot timer that posts an event once it expires, re-arming replaces the previous deadline
+   *
+   * Timers only advance in sleep(), which wakes up every tick while any timer is armed. Time is counted in whole
+   * ticks, so timers can run late by up to one tick, see now().
+   *
+   * @param timer Application defined timer slot, 0 to SCHEDULER_TIMERS - 1
+   * @param ms Time until expiry, in milliseconds
+   * @param event Event to post on expiry
+   */
+  static void setTimer(uint8_t timer, uint32_t ms, Event event);
+
+  /**
+   * Disarm a timer
+   *
+   * @param timer Timer slot, 0 to SCHEDULER_TIMERS - 1
+   */
+  static void cancelTimer(uint8_t timer);
+
+  /**
+   * Check whether a timer is armed
+   *
+   * @param timer Timer slot, 0 to SCHEDULER_TIMERS - 1
+   */
+  static bool isTimerArmed(uint8_t timer);
+
+  /**
+   * Sleep until an event is posted or the nearest timer expires
+   *
+   * Returns right away if an event was posted after the queue has been drained.
+   */
+  static void sleep(void);
+
+  /**
+   * Approximate milliseconds since reset, counted while any timer is armed
+   *
+   * Advances in whole ticks, so events within the same tick get the same time. A tick cut short by a posted event
+   * keeps running and is counted once it completes, as are ticks completed while awake. Time is lost only while no
+   * timer is armed.
+   */
+  static uint32_t now(void);
+
+private:
+  static Event queue[SCHEDULER_QUEUE_SIZE];
+  static volatile uint8_t head;
+  static volatile uint8_t count;
+
+  static uint32_t remaining[SCHEDULER_TIMERS]; /**< Time left per timer in milliseconds, 0 means disarmed */
+  static Event timerEvent[SCHEDULER_TIMERS];
+  static uint32_t clock;
+  static bool ticking; /**< WDT ticks are running */
+
+  /**
+   * Queue an event without waking the MCU up
+   *
+   * @return False if the queue is full
+   */
+  static bool push(Event event);
+
+  /**
+   * Advance all armed timers and post events for the expired ones
+   *
+   * @param ms Elapsed time, in milliseconds
+   */
+  static void elapse(uint32_t ms);
+};
+
+#endif //SCOUT_RF_SCHEDULER_H
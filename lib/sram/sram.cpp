@@ -0,0 +1,41 @@
+#include <avr/io.h>
+
+#include "sram.h"
+
+// End of .bss and the initial stack pointer, provided by the linker script.
+extern uint8_t _end;
+extern uint8_t __stack;
+
+// .init3 runs after the stack pointer has been set and r1 cleared, before .data and .bss are initialized. Naked and
+// not called, the code just falls through into the next section. Written in asm, GCC could turn a C loop into a
+// memset() call whose return address would sit on the very stack being painted.
+void paintStack(void) __attribute__((naked, used, section(".init3")));
+
+void paintStack(void) {
+  asm volatile (
+  "ldi r24, %[canary]\n"
+  "ldi r30, lo8(_end)\n"
+  "ldi r31, hi8(_end)\n"
+  "ldi r26, lo8(__stack)\n"
+  "ldi r27, hi8(__stack)\n"
+  "1: st Z+, r24\n"
+  "cp r26, r30\n"
+  "cpc r27, r31\n"
+  "brsh 1b\n"
+  ::[canary] "M" (SRAM_CANARY)
+  );
+}
+
+uint16_t Sram::unused(void) {
+  const uint8_t *p = &_end;
+
+  while (p <= &__stack && *p == SRAM_CANARY) {
+    p++;
+  }
+
+  return p - &_end;
+}
+
+uint16_t Sram::stackPeak(void) {
+  return &__stack - &_end + 1 - unused();
+}
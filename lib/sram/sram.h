@@ -0,0 +1,37 @@
+#ifndef SCOUT_RF_SRAM_H
+#define SCOUT_RF_SRAM_H
+
+#include <avr/io.h>
+
+/* SRAM budget through stack painting
+ *
+ * Linking this library paints everything between the end of .bss and the top of the stack with a canary pattern
+ * during startup, before main() and the initialization of globals. The stack grows down into the painted area, so
+ * the canaries left at its bottom are the RAM the firmware has never touched since reset: the margin before the stack
+ * runs into globals.
+ *
+ * @code
+ * LOG(LOG_SRAM, Sram::unused(), Sram::stackPeak());
+ * @endcode
+ *
+ * Nothing uses malloc(), the heap area is counted as free.
+ */
+
+#define SRAM_CANARY 0xc5
+
+class Sram {
+public:
+  /**
+   * Bytes between globals and the deepest stack so far, scans from the end of .bss up
+   *
+   * A stack frame that happens to leave a canary value at its very bottom makes it look a byte smaller.
+   */
+  static uint16_t unused(void);
+
+  /**
+   * Deepest the stack has been since reset, in bytes
+   */
+  static uint16_t stackPeak(void);
+};
+
+#endif //SCOUT_RF_SRAM_H
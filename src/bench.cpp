@@ -0,0 +1,72 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "halfduplexspi.h"
+#include "radio.h"
+#include "../bench/bench.h"
+
+/**
+ * Cycle-accurate microbenchmarks, built by the bench env and run under simavr, see bench/run.sh.
+ *
+ * No nRF24L01+ is attached in the simulator, MOMI reads back whatever the pin floats to. That doesn't change the
+ * cycle counts, except for paths which depend on the read value and those aren't benchmarked here.
+ */
+
+#define BENCH(id, code) \
+  do { \
+    GPIOR0 = BENCH_##id; \
+    code; \
+    GPIOR0 = BENCH_END; \
+  } while (0)
+
+volatile uint8_t sink;
+
+const uint8_t payload[32] = {80, 73, 78, 71, 0};
+uint8_t buffer[32];
+
+class RadioBench {
+public:
+  static void run(void);
+};
+
+void RadioBench::run(void) {
+  Radio radio;
+  radio.setup();
+
+  BENCH(EMPTY, );
+
+  BENCH(SPI_BYTE, sink = HalfDuplexSPI::byte(0xA5));
+  BENCH(SPI_IN, sink = HalfDuplexSPI::in());
+  BENCH(SPI_OUT, HalfDuplexSPI::out(0xA5));
+  BENCH(SPI_OUT_BURST, HalfDuplexSPI::outBurst(payload, 32));
+  BENCH(SPI_IN_BURST, HalfDuplexSPI::inBurst(buffer, 32));
+
+  BENCH(CSN_LOW, radio.csnLow());
+  BENCH(CSN_HIGH, radio.csnHigh());
+
+  BENCH(READ_REGISTER, sink = radio.read_register(RF_SETUP));
+  BENCH(WRITE_REGISTER, radio.write_register(RF_CH, 1));
+
+  BENCH(WRITE_PAYLOAD, radio.write_payload(payload, 5, W_TX_PAYLOAD));
+  BENCH(READ_PAYLOAD, radio.read_payload(buffer, 5));
+
+  radio.enableDynamicPayloads();
+  BENCH(WRITE_PAYLOAD_DYNAMIC, radio.write_payload(payload, 5, W_TX_PAYLOAD));
+  BENCH(READ_PAYLOAD_DYNAMIC, radio.read_payload(buffer, 5));
+
+  radio.powerDown();
+  BENCH(POWER_UP, radio.powerUp());
+
+  radio.startListening();
+  BENCH(STOP_LISTENING, radio.stopListening());
+}
+
+int main(void) {
+  RadioBench::run();
+
+  // simavr stops once the MCU sleeps with interrupts disabled.
+  GPIOR0 = BENCH_DONE;
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
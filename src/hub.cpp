@@ -0,0 +1,188 @@
+#include <avr/interrupt.h>
+
+// Highest rate the soft UART handles at 8MHz, 2.1% timing error.
+#define BAUD_RATE 230400
+
+#include "uart.h"
+#include "halfduplexspi.h"
+#include "radio.h"
+#include "network.h"
+
+/**
+ * Hub firmware, built by the hub env.
+ *
+ * Stays in RX mode on the quietest of HUB_CHANNELS, answers every frame with a PONG preloaded as ACK payload and
+ * streams received frames over UART. Retransmits whose ACK got lost are acknowledged again but not streamed, see
+ * SequenceWindow. Each frame is drained from the radio right away into a ring buffer, so the
+ * 3-slot RX FIFO is free again while the UART, the bottleneck at 43us per byte, catches up. Should the ring buffer
+ * fill up anyway, payloads stay in the RX FIFO and once that is full too the radio stops acknowledging, so scouts
+ * retry instead of losing frames.
+ *
+ * UART record per frame: 'R', pipe, length, payload.
+ *
+ * PB 0 - SPI MOMI
+ * PB 1 - nRF24L01+ IRQ (optional, build with -DRADIO_IRQ=PB1)
+ * PB 2 - SPI SCK
+ * PB 4 - UART
+ */
+
+// Power of 2 up to 256, frames take their length + 2 bytes.
+#ifndef HUB_BUFFER_SIZE
+#define HUB_BUFFER_SIZE 128
+#endif
+
+static_assert(HUB_BUFFER_SIZE <= 256 && !(HUB_BUFFER_SIZE & (HUB_BUFFER_SIZE - 1)),
+              "Hub buffer size must be a power of 2 up to 256");
+
+#ifdef RADIO_IRQ
+// Radio IRQ only has to wake the MCU up, see Radio::waitForIrq().
+EMPTY_INTERRUPT(PCINT0_vect);
+#endif
+
+// Channel 25 until surveyed, 250KBPS, -6dBm, 1500us/15 retries, 16-bit CRC, scouts on pipe 1, dynamic payload length
+// and ACK payloads on pipes 0 and 1.
+typedef RadioProfile<25, RATE_250KBPS, HIGH, 5, 15, CRC_16, ADDRESS_WIDTH, _BV(ERX_P1), 0b111111,
+    _BV(DPL_P0) | _BV(DPL_P1), true> HubProfile;
+
+SequenceWindow sequences;
+
+uint8_t ring[HUB_BUFFER_SIZE];
+uint8_t head = 0;
+uint8_t tail = 0;
+
+uint8_t used(void) {
+  return (uint8_t) (head - tail) & (HUB_BUFFER_SIZE - 1);
+}
+
+void push(uint8_t value) {
+  ring[head] = value;
+  head = (head + 1) & (HUB_BUFFER_SIZE - 1);
+}
+
+uint8_t pop(void) {
+  uint8_t value = ring[tail];
+  tail = (tail + 1) & (HUB_BUFFER_SIZE - 1);
+
+  return value;
+}
+
+/**
+ * Move every payload in the RX FIFO to the ring buffer
+ *
+ * @return Number of frames moved
+ */
+uint8_t drain(Radio &radio) {
+  uint8_t frames = 0;
+  uint8_t pipe;
+  uint8_t frame[32];
+
+  while (radio.available(&pipe)) {
+    uint8_t length = radio.getDynamicPayloadSize();
+
+    // Corrupted payload, already flushed.
+    if (!length) {
+      continue;
+    }
+
+    // One byte is always kept free, otherwise a full buffer would look empty.
+    if (HUB_BUFFER_SIZE - 1 - used() < length + 2) {
+      break;
+    }
+
+    radio.read(frame, length);
+
+    // ACK of this frame took the preloaded PONG, load one for the next frame on the pipe.
+    radio.writeAckPayload_P(pipe, pong, sizeof(pong));
+
+    uint32_t header = readFrameHeader(frame);
+
+    // Scout stops retrying once it has the PONG, there is nothing else to do about a duplicate or foreign frame.
+    if (!isFrameValid(header, length) || !sequences.accept(frameNode(header), frameEpoch(header), frameSequence(header))) {
+      continue;
+    }
+
+    push(pipe);
+    push(length);
+    for (uint8_t i = 0; i < length; i++) {
+      push(frame[i]);
+    }
+
+    frames++;
+  }
+
+  return frames;
+}
+
+/**
+ * Send the oldest frame of the ring buffer over UART
+ *
+ * @return False if the buffer is empty
+ */
+bool stream(void) {
+  if (!used()) {
+    return false;
+  }
+
+  TxByte('R');
+
+  uint8_t pipe = pop();
+  uint8_t length = pop();
+
+  TxByte(pipe);
+  TxByte(length);
+
+  while (length--) {
+    TxByte(pop());
+  }
+
+  return true;
+}
+
+void selectChannel(Radio &radio) {
+  uint8_t occupancy[CHANNEL_MAP_SIZE];
+  uint8_t channels[] = HUB_CHANNELS;
+
+  radio.surveyChannels(occupancy, 8);
+  Radio::rankChannels(occupancy, channels, sizeof(channels));
+
+  radio.setChannel(channels[0]);
+}
+
+int main(void) {
+  // Setup outputs. Set port to HIGH to signify UART default condition.
+  DDRB |= _BV(DDB4);
+  PORTB |= _BV(PB4);
+
+  sei();
+
+  Radio radio;
+
+  // Scouts find the hub by moving through HUB_CHANNELS, so the hub can just take the quietest one.
+  bool ready = radio.setup<HubProfile>();
+  selectChannel(radio);
+
+  // 'H', whether nRF24L01+ is set up and verified, channel.
+  TxByte('H');
+  TxByte(ready);
+  TxByte(radio.read_register(RF_CH));
+
+  radio.openReadingPipe_P(1, scoutPipe);
+  radio.startListening();
+
+  // One PONG per slot, so even a burst of 3 PINGs is answered before the hub gets to reload.
+  for (uint8_t i = 0; i < 3; i++) {
+    radio.writeAckPayload_P(1, pong, sizeof(pong));
+  }
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wmissing-noreturn"
+  while (true) {
+    // Radio is drained between frames, the RX FIFO never waits for more than one frame worth of UART time.
+    if (!drain(radio) && !stream()) {
+#ifdef RADIO_IRQ
+      radio.waitForIrq();
+#endif
+    }
+  }
+#pragma clang diagnostic pop
+}
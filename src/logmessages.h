@@ -0,0 +1,27 @@
+#ifndef SCOUT_RF_LOGMESSAGES_H
+#define SCOUT_RF_LOGMESSAGES_H
+
+#include "log.h"
+
+/* Log messages of the scout firmware, see log.h
+ *
+ * A token is the position in the table and host/logdecode.py parses this file to decode them, so only ever append to
+ * it and keep one X(token, level, "text") per line.
+ */
+
+#define SCOUT_MESSAGES(X) \
+  X(LOG_RADIO_READY, LOG_INFO, "nRF24L01+ is set up and verified!") \
+  X(LOG_RADIO_MISSING, LOG_ERROR, "nRF24L01+ DOES NOT respond or is not nRF24L01+ module!") \
+  X(LOG_CHANNEL, LOG_INFO, "Hub channel {u8}") \
+  X(LOG_LIGHT, LOG_DEBUG, "Light on: {u8} at {u32} ms") \
+  X(LOG_LIGHT_STILL_ON, LOG_WARN, "Light is still on") \
+  X(LOG_PANIC, LOG_WARN, "Panic ping sending...") \
+  X(LOG_SENT, LOG_DEBUG, "Attempt {u8} has been sent, {u8} retransmits") \
+  X(LOG_NOT_SENT, LOG_DEBUG, "Attempt {u8} has not been sent") \
+  X(LOG_NO_PONG, LOG_DEBUG, "ACK came without PONG") \
+  X(LOG_SESSION, LOG_INFO, "Ping session delivered: {u8}, attempts: {u8}, output power: {u8}") \
+  X(LOG_SRAM, LOG_DEBUG, "SRAM never used: {u16} bytes, stack peak: {u16} bytes")
+
+LOG_DEFINE(SCOUT_MESSAGES)
+
+#endif //SCOUT_RF_LOGMESSAGES_H
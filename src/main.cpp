@@ -1,102 +1,353 @@
 #include <avr/interrupt.h>
-#include <avr/sleep.h>
-#include <util/delay.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
 #include "uart.h"
 #include "halfduplexspi.h"
+#include "eventbatch.h"
+#include "lightsensor.h"
+#include "log.h"
+#include "logmessages.h"
+#include "lowpower.h"
+#include "metrics.h"
 #include "radio.h"
+#include "retrypolicy.h"
+#include "scheduler.h"
+#include "sram.h"
+#include "network.h"
 
 /**
  * PB 0 - SPI MOMI
- * PB 1 -
+ * PB 1 - nRF24L01+ IRQ (optional, build with -DRADIO_IRQ=PB1)
  * PB 2 - SPI SCK
- * PB 3 - External interrupt from light sensor
+ * PB 3 - External interrupt from light sensor, or ADC3 when built with -DLIGHT_ADC
  * PB 4 - UART
  * PB 5 - Reset
  */
 
-#define DEBUG 1
+// Node id sent with every frame, 1-255 and unique per hub. Build with -DNODE_ID=n.
+#ifndef NODE_ID
+#define NODE_ID 1
+#endif
+
+static_assert(NODE_ID != HUB_NODE && NODE_ID <= 0xff, "NODE_ID must be 1-255");
+
+// Epoch of the previous run, the hub takes a new one as a reset and forgets the sequence numbers it has seen.
+uint8_t EEMEM storedEpoch = 0;
+uint8_t epoch = 0;
+
+// Pin change has to hold for at least this long to count as an edge, up to a Scheduler tick longer.
+#ifndef DEBOUNCE_MS
+#define DEBOUNCE_MS 16
+#endif
+
+enum AppEvent {
+  EVENT_EDGE = 0,
+  EVENT_PING_RETRY,
+  EVENT_PANIC,
+  EVENT_FLUSH,
+  EVENT_SAMPLE,
+  EVENT_DEBOUNCE
+};
+
+enum AppTimer {
+  TIMER_PING = 0,
+  TIMER_PANIC,
+  TIMER_BATCH,
+  TIMER_LIGHT /**< Sampling with LIGHT_ADC, debounce otherwise */
+};
+
+#ifdef LIGHT_ADC
+#ifdef RADIO_IRQ
+// Light sensor is sampled, radio IRQ only has to wake us up.
+EMPTY_INTERRUPT(PCINT0_vect);
+#endif
+#elif defined(RADIO_IRQ)
+volatile uint8_t lastPins = 0;
 
-volatile bool interrupt = false;
+ISR(PCINT0_vect) {
+  // Radio IRQ shares the vector and only has to wake us up, light sensor edges are the only ones that count here.
+  uint8_t pins = PINB;
 
-uint8_t lightOnCounter = 0;
+  // Masked until debounced, a bouncing or noisy input wakes us up once.
+  if ((PCMSK & _BV(PCINT3)) && ((pins ^ lastPins) & _BV(PINB3))) {
+    PCMSK &= ~_BV(PCINT3);
+    Scheduler::post(EVENT_EDGE);
+  }
 
+  lastPins = pins;
+}
+#else
 ISR(PCINT0_vect) {
-  interrupt = true;
+  // Masked until debounced, a bouncing or noisy input wakes us up once.
+  PCMSK &= ~_BV(PCINT3);
+  Scheduler::post(EVENT_EDGE);
 }
+#endif
+
+#ifndef LIGHT_ADC
+// Light state as of the last confirmed edge and time of the pin change being debounced.
+bool lightOn = false;
+uint32_t edgeTime = 0;
+#endif
+
+// PONG comes back as the payload of the hub's ACK, so there is no reading pipe.
+uint8_t rxData[FRAME_HEADER_SIZE];
+
+// If the light is on for more than 10 sec, something is wrong, send additional ping every minute to draw attention.
+const uint32_t panicThreshold = 10000;
+const uint32_t panicPeriod = 60000;
+
+// Edges after a ping session are batched for up to 30 sec, one after a quiet period goes out right away.
+const uint32_t maxLatency = 30000;
+
+// Number of ping attempts made so far, 0 if there is no ping in progress.
+uint8_t pingAttempts = 0;
+
+// EventFlag bits of the frame sent by the current or next ping session.
+uint8_t pingFlags = 0;
+
+EventBatch events;
+uint8_t frame[EVENT_FRAME_SIZE];
+
+// Ranked from the quietest one at boot, the scout moves on to the next one whenever a ping session stays unanswered.
+uint8_t hubChannels[] = HUB_CHANNELS;
+uint8_t hubChannel = 0;
+
+// ACK with payload at 250KBPS needs 1500us, RetryPolicy only ever makes it longer.
+const uint8_t minRetryDelay = 5;
+
+// Channel 25 until surveyed, 250KBPS, -6dBm, 1500us/15 retries, 16-bit CRC, dynamic payload length and ACK payloads
+// on pipe 0.
+typedef RadioProfile<25, RATE_250KBPS, HIGH, minRetryDelay, 15, CRC_16, ADDRESS_WIDTH, _BV(ERX_P0), 0b111111,
+    _BV(DPL_P0), true> ScoutProfile;
+
+// Ping is retried with a growing, randomized gap until PONG comes back, see RetryPolicy.
+RetryPolicy retryPolicy(minRetryDelay);
+
+// With CE tied high a powered up PTX with an empty TX FIFO idles in standby-II at 320uA. Powering it back up busy-waits
+// 5ms at a few mA, which standby-II burns through in about 100ms, so gaps at least this long are spent powered down.
+const uint32_t powerDownGap = 100;
+
+bool checkPong(Radio &radio) {
+  bool isPongReceived = false;
+
+  if (radio.available()) {
+    radio.read(&rxData, sizeof(rxData));
+
+    isPongReceived = readFrameHeader(rxData) == pongHeader;
+  }
+
+  if (!isPongReceived) {
+    LOG(LOG_NO_PONG);
+  }
 
-// {"PING"} = {80, 73, 78, 71, 0}.
-const uint8_t data[5] = {80, 73, 78, 71, 0};
-// {"PONG"} = {80, 79, 78, 71, 0}.
-uint8_t rxData[5] = {0, 0, 0, 0, 0};
+  return isPongReceived;
+}
 
-const uint8_t txPipe[5] = {0x7C, 0x68, 0x52, 0x4d, 0x54};
-const uint8_t rxPipe[5] = {0x71, 0xCD, 0xAB, 0xCD, 0xAB};
+void finishPing(Radio &radio, bool delivered) {
+  LOG(LOG_SESSION, (uint8_t) delivered, pingAttempts, (uint8_t) radio.getOutputPower());
+  LOG(LOG_SRAM, Sram::unused(), Sram::stackPeak());
 
-const uint32_t timeoutPeriod = 3000;
+  pingAttempts = 0;
+  retryPolicy.finished(delivered);
 
-void debug(const uint8_t *str, bool newLine = true) {
-#ifdef DEBUG
-  while (*str) {
-    TxByte(*str++);
+  if (delivered) {
+    events.acknowledge();
+    pingFlags = 0;
   }
 
-  if (newLine) {
-    TxByte('\n');
+  // Undelivered edges and those coming in meanwhile go out with the next session at the latest.
+  Scheduler::setTimer(TIMER_BATCH, maxLatency, EVENT_FLUSH);
+
+  if (!delivered) {
+    if (++hubChannel == sizeof(hubChannels)) {
+      hubChannel = 0;
+    }
+    radio.setChannel(hubChannels[hubChannel]);
+    LOG(LOG_CHANNEL, hubChannels[hubChannel]);
   }
+
+  radio.powerDown();
+
+#ifdef METRICS
+  // One record per ping session.
+  Metrics::dump(TxByte);
+  Metrics::reset();
 #endif
 }
 
-void debug(const char *str, bool newLine = true) {
-  debug((const uint8_t *) str, newLine);
+bool isLightOn(void) {
+#ifdef LIGHT_ADC
+  return LightSensor::isOn();
+#else
+  return lightOn;
+#endif
 }
 
-void sendPing(Radio radio) {
-  radio.powerUp();
+#ifndef LIGHT_ADC
+bool readLight(void) {
+  // Light is on while PB3 is low.
+  return !(PINB & _BV(PINB3));
+}
+#endif
 
-  bool isPongReceived = false;
+void sendPing(Radio &radio) {
+  pingAttempts++;
 
-  for (uint8_t counter = 0; counter < 10; counter++) {
-    radio.openWritingPipe(txPipe);
-    radio.openReadingPipe(rxPipe);
-    radio.stopListening();
-
-    // If retries are failing and the user defined timeout is exceeded, let's indicate a failure and set the fail
-    // count to maximum and break out of the for loop.
-    if (!radio.writeBlocking(&data, 5, timeoutPeriod)) {
-      debug("Message has not been sent");
-    } else {
-      debug("Message has been sent!");
+  // Same sequence number and edges for every attempt until delivered, edges recorded in between wait for the next one.
+  uint8_t flags = pingFlags | (isLightOn() ? EVENT_FLAG_LIGHT : 0);
+  uint8_t length = events.encode(frame, NODE_ID, epoch, flags, Scheduler::now());
+
+  radio.openWritingPipe_P(scoutPipe);
+  radio.stopListening();
+  retryPolicy.apply(radio);
+
+#ifdef RADIO_IRQ
+  // Sleep until the radio tells whether PING has been acknowledged or retries ran out.
+  bool sent = radio.write(frame, length) & IRQ_TX_SENT;
+#else
+  // Wait for the outcome, retransmits of the payload are only known once it's acknowledged.
+  bool sent = radio.writeFast(frame, length) && radio.txStandBy();
+#endif
+
+  if (sent) {
+    retryPolicy.sent(radio.getRetransmits());
+    LOG(LOG_SENT, pingAttempts, radio.getRetransmits());
+  } else {
+    retryPolicy.failed();
+    LOG(LOG_NOT_SENT, pingAttempts);
+  }
+
+  // PONG, if the hub had one loaded, came back with the ACK and is already in the RX FIFO.
+  bool isPongReceived = sent && checkPong(radio);
+
+  if (isPongReceived || pingAttempts >= retryPolicy.maxAttempts()) {
+    finishPing(radio, isPongReceived);
+  } else {
+    uint32_t backoff = retryPolicy.backoff(pingAttempts);
+
+    if (backoff >= powerDownGap) {
+      radio.powerDown();
     }
 
-    radio.openWritingPipe(txPipe);
-    radio.openReadingPipe(rxPipe);
-    radio.startListening();
+    Scheduler::setTimer(TIMER_PING, backoff, EVENT_PING_RETRY);
+  }
+}
+
+void startPing(Radio &radio) {
+  // Ping in progress covers this event too.
+  if (pingAttempts) {
+    return;
+  }
+
+  Scheduler::cancelTimer(TIMER_BATCH);
+  radio.powerUp();
+  sendPing(radio);
+}
 
-    if (radio.available()) {
-      radio.read(&rxData, 5);
+void selectChannel(Radio &radio) {
+  uint8_t occupancy[CHANNEL_MAP_SIZE];
 
-      debug("Message has been received: ");
-      debug(rxData);
+  radio.surveyChannels(occupancy, 8);
+  Radio::rankChannels(occupancy, hubChannels, sizeof(hubChannels));
 
-      // {"PONG"} = {80, 79, 78, 71, 0}.
-      if (rxData[0] == 80 && rxData[1] == 79 && rxData[2] == 78 && rxData[3] == 71 && rxData[4] == 0) {
-        isPongReceived = true;
-      }
+  hubChannel = 0;
+  radio.setChannel(hubChannels[hubChannel]);
+  LOG(LOG_CHANNEL, hubChannels[hubChannel]);
+}
+
+void checkLight(void) {
+  if (!isLightOn()) {
+    Scheduler::cancelTimer(TIMER_PANIC);
+  } else if (!Scheduler::isTimerArmed(TIMER_PANIC)) {
+    LOG(LOG_LIGHT_STILL_ON);
+    Scheduler::setTimer(TIMER_PANIC, panicThreshold + panicPeriod, EVENT_PANIC);
+  }
+}
+
+/**
+ * Handle a confirmed change of isLightOn()
+ *
+ * @param time When the change happened, see Scheduler::now()
+ */
+void lightChanged(Radio &radio, uint32_t time) {
+  LOG(LOG_LIGHT, (uint8_t) isLightOn(), time);
+  events.record(isLightOn(), time);
+
+  // Batching window is open for a while after each session, otherwise there was nothing to batch with.
+  if (events.full() || !Scheduler::isTimerArmed(TIMER_BATCH)) {
+    startPing(radio);
+  }
+
+  checkLight();
+}
 
-      rxData[0] = rxData[1] = rxData[2] = rxData[3] = rxData[4] = 0;
+void handle(Radio &radio, Event event) {
+  switch (event) {
+#ifndef LIGHT_ADC
+    case EVENT_EDGE:
+      // Edge is timed here, only the direction waits for the level to settle.
+      edgeTime = Scheduler::now();
+      Scheduler::setTimer(TIMER_LIGHT, DEBOUNCE_MS, EVENT_DEBOUNCE);
+      break;
+
+    case EVENT_DEBOUNCE: {
+      // Unmasked before the level is read, a change from here on starts over.
+#ifdef RADIO_IRQ
+      // Pin may have settled back while masked without an interrupt, the next edge is relative to the level now.
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        PCMSK |= _BV(PCINT3);
+        lastPins = PINB;
+      }
+#else
+      PCMSK |= _BV(PCINT3);
+#endif
 
-      if (isPongReceived) {
-        break;
+      // Glitches are back to the previous level by now, and so is a pulse shorter than DEBOUNCE_MS.
+      bool on = readLight();
+      if (on != lightOn) {
+        lightOn = on;
+        lightChanged(radio, edgeTime);
       }
-    } else {
-      debug("No data is available!");
+      break;
     }
+#endif
 
-    _delay_ms(1000);
-  }
+    case EVENT_FLUSH:
+      // Window closes without a session if nothing has happened.
+      if (!events.empty()) {
+        startPing(radio);
+      }
+      break;
 
-  radio.stopListening();
-  radio.powerDown();
+#ifdef LIGHT_ADC
+    case EVENT_SAMPLE:
+      Scheduler::setTimer(TIMER_LIGHT, LIGHT_SAMPLE_MS, EVENT_SAMPLE);
+
+      // Averaged and with hysteresis, only a real change counts as an edge.
+      if (LightSensor::update()) {
+        lightChanged(radio, Scheduler::now());
+      }
+      break;
+#endif
+
+    case EVENT_PING_RETRY:
+      // No-op unless powered down for a long gap.
+      radio.powerUp();
+      sendPing(radio);
+      break;
+
+    case EVENT_PANIC:
+      // Light has been on all the time, otherwise the timer would have been cancelled.
+      LOG(LOG_PANIC);
+      pingFlags |= EVENT_FLAG_PRIORITY;
+      startPing(radio);
+      Scheduler::setTimer(TIMER_PANIC, panicPeriod, EVENT_PANIC);
+      break;
+
+    default:
+      break;
+  }
 }
 
 int main(void) {
@@ -104,86 +355,73 @@ int main(void) {
   DDRB |= _BV(DDB4);
   PORTB |= _BV(PB4);
 
-  // Setup external interrupt pin.
   DDRB &= ~_BV(DDB3);
+
+#ifndef LIGHT_ADC
+  lightOn = readLight();
+
+  // Setup external interrupt pin.
   PCMSK |= _BV(PCINT3);
   GIMSK |= _BV(PCIE);
 
+#ifdef RADIO_IRQ
+  lastPins = PINB;
+#endif
+#endif
+
   sei();
 
+#ifdef LIGHT_ADC
+  // Sampled on a WDT timed Scheduler timer instead of waking up on every pin change.
+  LightSensor::setup();
+  Scheduler::setTimer(TIMER_LIGHT, LIGHT_SAMPLE_MS, EVENT_SAMPLE);
+#endif
+
+  LOG_SETUP(TxByte);
+  METRICS_SETUP();
+
+  // Sequence numbers start over with every reset, a new epoch tells the hub they aren't retransmits.
+  epoch = (eeprom_read_byte(&storedEpoch) + 1) & (FRAME_EPOCHS - 1);
+  eeprom_update_byte(&storedEpoch, epoch);
+
+  // WDT oscillator drifts with supply voltage and temperature, measure it once against the system clock.
+  // Calibration clusters around the same value on every board, so nodes' retries are kept apart by their id and by
+  // ADC noise instead, which also differs between runs of the same node.
+  uint16_t scale = LowPower::calibrate();
+  retryPolicy.seed(scale ^ (uint16_t) NODE_ID << 8 ^ NODE_ID ^ LightSensor::noise());
+
   Radio radio;
 
-  if (radio.setup()) {
-    debug("nRF24L01+ is set up and ready!");
+  // Radio is left powered up in PTX mode, so there is no need for stopListening() here.
+  if (radio.setup<ScoutProfile>()) {
+    LOG(LOG_RADIO_READY);
   } else {
-    debug("nRF24L01+ DOES NOT respond!");
+    LOG(LOG_RADIO_MISSING);
   }
 
-  radio.setChannel(1);
-  radio.setOutputPower(OutputPower::HIGH);
+  // Profile power is only where a brand new scout starts, afterwards it's the lowest level the hub still hears.
+  radio.enablePowerControl();
 
-  if (radio.setDataRate(DataRate::RATE_250KBPS)) {
-    debug("nRF24L01+ is verified!");
-  } else {
-    debug("This is not nRF24L01+ module!");
-  }
+  selectChannel(radio);
 
-  radio.setAutoAck(1);
-  radio.setRetries(2, 15);
-  radio.openWritingPipe(txPipe);
-  radio.openReadingPipe(rxPipe);
-  radio.stopListening();
+  radio.openWritingPipe_P(scoutPipe);
+
+  // Don't rely on an edge if light is on by default.
+  checkLight();
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmissing-noreturn"
   while (true) {
-    if (interrupt) {
-      debug("INTERRUPT");
-
-      sendPing(radio);
-    } else {
-      debug("NO INTERRUPT");
-    }
-
-    lightOnCounter = 0;
-
-    // Don't go sleep if light is on by default.
-    while(!(PINB & _BV(PINB3))) {
-      debug("Light is still on....");
-      _delay_ms(1000);
-
-      // If the light is on more than 10 sec, something is wrong let's send additional ping every minute to draw
-      // attention.
-      if (lightOnCounter > 10) {
-        debug("Panic ping sending...");
-        _delay_ms(60000);
-        sendPing(radio);
-
-        if (lightOnCounter > 200) {
-          lightOnCounter = 0;
-        }
-      }
-
-      lightOnCounter++;
+    Event event;
+    while (Scheduler::next(event)) {
+      handle(radio, event);
     }
 
-    interrupt = false;
-
-    debug("Sleeping...");
-
-    PORTB &= ~_BV(DDB4);
-
-    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
-    cli();
-    sleep_enable();
-    sei();
-    sleep_cpu();
-    sleep_disable();
-    sei();
+    PORTB &= ~_BV(PB4);
 
-    PORTB |= _BV(DDB4);
+    Scheduler::sleep();
 
-    debug("Waking!");
+    PORTB |= _BV(PB4);
   }
 #pragma clang diagnostic pop
 }
\ No newline at end of file
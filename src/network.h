@@ -0,0 +1,27 @@
+#ifndef SCOUT_RF_NETWORK_H
+#define SCOUT_RF_NETWORK_H
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "frame.h"
+
+/* What scouts and the hub have to agree on, shared by src/main.cpp and src/hub.cpp.
+ *
+ * Constant tables stay in flash, use the _P variants of the Radio API with them. */
+
+// Scouts send to this address, the hub listens on it on pipe 1.
+const uint8_t scoutPipe[5] PROGMEM = {0x7C, 0x68, 0x52, 0x4d, 0x54};
+
+// Channels the hub may listen on, 2400 + n MHz: in the gaps between Wi-Fi channels 1, 6 and 11 and above 11, all
+// within the 2400-2483.5 MHz ISM band.
+#define HUB_CHANNELS {25, 50, 76, 80}
+
+// Scouts send FRAME_EVENTS frames, see eventbatch.h.
+
+// Sent back as the payload of the hub's ACK, a bare header.
+constexpr uint32_t pongHeader = frameHeader(HUB_NODE, 0, FRAME_PONG, 0, 0);
+const uint8_t pong[FRAME_HEADER_SIZE] PROGMEM = {
+    frameByte(pongHeader, 0), frameByte(pongHeader, 1), frameByte(pongHeader, 2), frameByte(pongHeader, 3)
+};
+
+#endif //SCOUT_RF_NETWORK_H